@@ -0,0 +1,222 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <algorithm>
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/uinteger.h"
+#include "ns3/event-impl.h"
+#include "bucket-scheduler.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BucketScheduler");
+
+NS_OBJECT_ENSURE_REGISTERED (BucketScheduler);
+
+// orders the std heap functions so the earliest event is on top
+static bool
+LaterEvent (const Scheduler::Event &a, const Scheduler::Event &b)
+{
+  return b < a;
+}
+
+TypeId
+BucketScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BucketScheduler")
+    .SetParent<Scheduler> ()
+    .AddConstructor<BucketScheduler> ()
+    .AddAttribute ("BucketWidth",
+                   "The span of simulation time covered by one bucket.",
+                   TimeValue (MilliSeconds (1)),
+                   MakeTimeAccessor (&BucketScheduler::m_width),
+                   MakeTimeChecker ())
+    .AddAttribute ("NumBuckets",
+                   "The number of buckets in the ring, rounded up to a "
+                   "power of two.",
+                   UintegerValue (256),
+                   MakeUintegerAccessor (&BucketScheduler::SetNumBuckets),
+                   MakeUintegerChecker<uint32_t> (2))
+  ;
+  return tid;
+}
+
+BucketScheduler::BucketScheduler ()
+  : m_window (0),
+    m_ring_count (0)
+{
+  NS_LOG_FUNCTION (this);
+  SetNumBuckets (256);
+}
+
+BucketScheduler::~BucketScheduler ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BucketScheduler::SetNumBuckets (uint32_t n)
+{
+  NS_LOG_FUNCTION (this << n);
+  NS_ASSERT_MSG (IsEmpty (), "resizing a scheduler that holds events");
+  uint32_t size = 2;
+  while (size < n)
+    {
+      size <<= 1;
+    }
+  m_ring.assign (size, Bucket ());
+  m_mask = size - 1;
+}
+
+uint64_t
+BucketScheduler::GetWidth (void) const
+{
+  // read on every use: the time resolution may be set after construction
+  uint64_t width = m_width.GetTimeStep ();
+  return width > 0 ? width : 1;
+}
+
+void
+BucketScheduler::Insert (const Event &ev)
+{
+  NS_LOG_FUNCTION (this << ev.impl << ev.key.m_ts << ev.key.m_uid);
+  uint64_t width = GetWidth ();
+  uint64_t bucket = ev.key.m_ts / width;
+  uint64_t current = m_window / width;
+  if (IsEmpty ())
+    {
+      // nothing queued: move the window to the new event
+      m_window = bucket * width;
+      current = bucket;
+    }
+
+  if (bucket <= current)
+    {
+      m_current.push_back (ev);
+      std::push_heap (m_current.begin (), m_current.end (), LaterEvent);
+    }
+  else if (bucket - current <= m_mask)
+    {
+      m_ring[bucket & m_mask].push_back (ev);
+      m_ring_count++;
+    }
+  else
+    {
+      m_overflow.insert (std::make_pair (ev.key, ev.impl));
+    }
+  Refill ();
+}
+
+bool
+BucketScheduler::IsEmpty (void) const
+{
+  return m_current.empty () && m_ring_count == 0 && m_overflow.empty ();
+}
+
+Scheduler::Event
+BucketScheduler::PeekNext (void) const
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (!m_current.empty ());
+  return m_current.front ();
+}
+
+Scheduler::Event
+BucketScheduler::RemoveNext (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (!m_current.empty ());
+  std::pop_heap (m_current.begin (), m_current.end (), LaterEvent);
+  Event next = m_current.back ();
+  m_current.pop_back ();
+  Refill ();
+  return next;
+}
+
+void
+BucketScheduler::Remove (const Event &ev)
+{
+  NS_LOG_FUNCTION (this << ev.impl << ev.key.m_ts << ev.key.m_uid);
+  for (Bucket::iterator it = m_current.begin (); it != m_current.end (); it++)
+    {
+      if (it->key.m_uid == ev.key.m_uid)
+        {
+          m_current.erase (it);
+          std::make_heap (m_current.begin (), m_current.end (), LaterEvent);
+          Refill ();
+          return;
+        }
+    }
+  Bucket &bucket = m_ring[(ev.key.m_ts / GetWidth ()) & m_mask];
+  for (Bucket::iterator it = bucket.begin (); it != bucket.end (); it++)
+    {
+      if (it->key.m_uid == ev.key.m_uid)
+        {
+          bucket.erase (it);
+          m_ring_count--;
+          return;
+        }
+    }
+  Overflow::iterator it = m_overflow.find (ev.key);
+  NS_ASSERT (it != m_overflow.end ());
+  m_overflow.erase (it);
+}
+
+void
+BucketScheduler::Refill (void)
+{
+  uint64_t width = GetWidth ();
+  while (m_current.empty () && !IsEmpty ())
+    {
+      if (m_ring_count == 0)
+        {
+          // nothing within the horizon: jump to the first overflow event
+          m_window = (m_overflow.begin ()->first.m_ts / width) * width;
+        }
+      else
+        {
+          m_window += width;
+        }
+      uint64_t bucket = m_window / width;
+      m_current.swap (m_ring[bucket & m_mask]);
+      m_ring_count -= m_current.size ();
+
+      // pull in overflow events that now fall within the ring
+      uint64_t horizon = m_window + (uint64_t)m_mask * width + width;
+      while (!m_overflow.empty () && m_overflow.begin ()->first.m_ts < horizon)
+        {
+          Event ev;
+          ev.key = m_overflow.begin ()->first;
+          ev.impl = m_overflow.begin ()->second;
+          m_overflow.erase (m_overflow.begin ());
+          uint64_t b = ev.key.m_ts / width;
+          if (b == bucket)
+            {
+              m_current.push_back (ev);
+            }
+          else
+            {
+              m_ring[b & m_mask].push_back (ev);
+              m_ring_count++;
+            }
+        }
+      std::make_heap (m_current.begin (), m_current.end (), LaterEvent);
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,82 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef BUCKET_SCHEDULER_H
+#define BUCKET_SCHEDULER_H
+
+#include <map>
+#include <vector>
+#include "ns3/scheduler.h"
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+class EventImpl;
+
+/**
+ * \ingroup udpgossip
+ * \brief A scheduler for many short, bounded-delay timers
+ *
+ * The gossip workload is dominated by events due within the next few
+ * hundred milliseconds (send jitter and link deliveries).  Those are
+ * dropped unsorted into a ring of fixed-width time buckets, so inserting
+ * one is O(1).  Only the bucket being drained is kept as a binary heap;
+ * a bucket is heapified when the clock reaches it.  Events beyond the
+ * ring's horizon wait in a sorted map and are pulled in as their bucket
+ * comes up.
+ *
+ * Choose BucketWidth so that a bucket holds a modest number of events
+ * and NumBuckets so that the ring covers the usual scheduling horizon.
+ */
+class BucketScheduler : public Scheduler
+{
+public:
+  static TypeId GetTypeId (void);
+
+  BucketScheduler ();
+  virtual ~BucketScheduler ();
+
+  virtual void Insert (const Event &ev);
+  virtual bool IsEmpty (void) const;
+  virtual Event PeekNext (void) const;
+  virtual Event RemoveNext (void);
+  virtual void Remove (const Event &ev);
+
+private:
+  typedef std::vector<Event> Bucket;
+  typedef std::map<Scheduler::EventKey, EventImpl*> Overflow;
+
+  void SetNumBuckets (uint32_t n);
+  uint64_t GetWidth (void) const;
+  /**
+   * Make m_current hold the earliest events, moving the window forward
+   * over empty buckets, as long as anything is queued.
+   */
+  void Refill (void);
+
+  Time m_width;                 //!< time covered by one bucket
+  std::vector<Bucket> m_ring;   //!< buckets after the current one
+  uint32_t m_mask;              //!< ring size - 1
+  uint64_t m_window;            //!< start of the current bucket's time
+  Bucket m_current;             //!< heap of the events in the current bucket
+  uint32_t m_ring_count;        //!< events in m_ring
+  Overflow m_overflow;          //!< events beyond the ring's horizon
+};
+
+} // namespace ns3
+
+#endif /* BUCKET_SCHEDULER_H */
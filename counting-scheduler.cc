@@ -0,0 +1,128 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/string.h"
+#include "ns3/object-factory.h"
+#include "counting-scheduler.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("CountingScheduler");
+
+NS_OBJECT_ENSURE_REGISTERED (CountingScheduler);
+
+uint64_t CountingScheduler::g_inserted = 0;
+uint64_t CountingScheduler::g_removed = 0;
+uint64_t CountingScheduler::g_peak_size = 0;
+
+TypeId
+CountingScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::CountingScheduler")
+    .SetParent<Scheduler> ()
+    .AddConstructor<CountingScheduler> ()
+    .AddAttribute ("Inner",
+                   "The TypeId name of the scheduler being measured.",
+                   StringValue ("ns3::MapScheduler"),
+                   MakeStringAccessor (&CountingScheduler::SetInner),
+                   MakeStringChecker ())
+  ;
+  return tid;
+}
+
+CountingScheduler::CountingScheduler ()
+  : m_size (0)
+{
+  NS_LOG_FUNCTION (this);
+  SetInner ("ns3::MapScheduler");
+}
+
+CountingScheduler::~CountingScheduler ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+CountingScheduler::SetInner (std::string type)
+{
+  NS_LOG_FUNCTION (this << type);
+  NS_ASSERT_MSG (m_size == 0, "replacing a scheduler that holds events");
+  ObjectFactory factory;
+  factory.SetTypeId (type);
+  m_inner = factory.Create<Scheduler> ();
+}
+
+void
+CountingScheduler::Insert (const Event &ev)
+{
+  m_inner->Insert (ev);
+  g_inserted++;
+  m_size++;
+  if (m_size > g_peak_size)
+    {
+      g_peak_size = m_size;
+    }
+}
+
+bool
+CountingScheduler::IsEmpty (void) const
+{
+  return m_inner->IsEmpty ();
+}
+
+Scheduler::Event
+CountingScheduler::PeekNext (void) const
+{
+  return m_inner->PeekNext ();
+}
+
+Scheduler::Event
+CountingScheduler::RemoveNext (void)
+{
+  g_removed++;
+  m_size--;
+  return m_inner->RemoveNext ();
+}
+
+void
+CountingScheduler::Remove (const Event &ev)
+{
+  m_size--;
+  m_inner->Remove (ev);
+}
+
+uint64_t
+CountingScheduler::GetInserted (void)
+{
+  return g_inserted;
+}
+
+uint64_t
+CountingScheduler::GetRemoved (void)
+{
+  return g_removed;
+}
+
+uint64_t
+CountingScheduler::GetPeakSize (void)
+{
+  return g_peak_size;
+}
+
+} // namespace ns3
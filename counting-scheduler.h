@@ -0,0 +1,77 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef COUNTING_SCHEDULER_H
+#define COUNTING_SCHEDULER_H
+
+#include <string>
+#include "ns3/scheduler.h"
+#include "ns3/ptr.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup udpgossip
+ * \brief Wraps another scheduler and counts what goes through it
+ *
+ * Used to compare event-queue implementations on the same workload.
+ * The counts are kept process-wide so they can still be read after the
+ * simulator has been destroyed.
+ */
+class CountingScheduler : public Scheduler
+{
+public:
+  static TypeId GetTypeId (void);
+
+  CountingScheduler ();
+  virtual ~CountingScheduler ();
+
+  virtual void Insert (const Event &ev);
+  virtual bool IsEmpty (void) const;
+  virtual Event PeekNext (void) const;
+  virtual Event RemoveNext (void);
+  virtual void Remove (const Event &ev);
+
+  /**
+   * \return the number of events inserted so far
+   */
+  static uint64_t GetInserted (void);
+
+  /**
+   * \return the number of events taken off the queue to run
+   */
+  static uint64_t GetRemoved (void);
+
+  /**
+   * \return the largest number of events queued at once
+   */
+  static uint64_t GetPeakSize (void);
+
+private:
+  void SetInner (std::string type);
+
+  Ptr<Scheduler> m_inner; //!< the scheduler doing the actual work
+  uint64_t m_size;        //!< events currently queued
+
+  static uint64_t g_inserted;
+  static uint64_t g_removed;
+  static uint64_t g_peak_size;
+};
+
+} // namespace ns3
+
+#endif /* COUNTING_SCHEDULER_H */
@@ -17,18 +17,55 @@
 #ifndef DMC_DATA_H
 #define DMC_DATA_H
 
+#include <vector>
 #include "ns3/ipv4-address.h"
 
 namespace ns3 {
+
+  // A piece of a marshalled message small enough for one packet
+  struct DmcSegment {
+    uint32_t offset;
+    uint32_t length;
+  };
   
   class DmcData {
 
   public:
-    virtual uint32_t GetMarshalledSize() = 0;
+    // Size of the message MarshalTo would write; no side effects, since
+    // observers and checkpoints ask too
+    virtual uint32_t GetMarshalledSize() const = 0;
     virtual void MarshalTo(uint8_t const *buf) = 0;
     virtual void MarshalFrom(uint8_t const *buf) = 0;
     virtual void LogMemory() = 0;
+    // Identify this node; the node id comes first.
+    virtual void SetMyNodeId(uint32_t node_id) = 0;
     virtual void SetMyIpv4Address(Ipv4Address me) = 0;
+
+    // Topology churn: the direct neighbor with this node id became
+    // unreachable, or this node rejoins the network with nothing but its
+    // own identity and value.
+    virtual void NeighborDown(uint32_t node_id) = 0;
+    virtual void Reset() = 0;
+
+    // Called once before each message is marshalled for sending, for
+    // upkeep that should run at the pace of the protocol rather than
+    // whenever someone looks at the state.
+    virtual void PrepareToSend() = 0;
+
+    // Full protocol state for checkpoints; unlike the marshalled message
+    // this includes everything needed to resume where we left off.
+    virtual uint32_t GetSnapshotSize() = 0;
+    virtual void SnapshotTo(uint8_t const *buf) = 0;
+    virtual void RestoreFrom(uint8_t const *buf) = 0;
+
+    // Split the size-byte message in buf, as just written by MarshalTo,
+    // into segments of at most max_bytes, listed in the order they
+    // should be sent.  The receiver reassembles the whole message before
+    // MarshalFrom sees it, so the split only decides what travels
+    // together and what goes first.
+    virtual void Segment(uint8_t const *buf, uint32_t size,
+                         uint32_t max_bytes,
+                         std::vector<DmcSegment> &segments) = 0;
   };
 
   class DmcDataFactory {
@@ -21,30 +21,325 @@
 #include "ns3/internet-module.h"
 #include "ns3/point-to-point-module.h"
 #include "ns3/applications-module.h"
+#include "ns3/system-wall-clock-ms.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("DMC");
 
+static bool g_timing = false;
+
+// report the wall-clock time spent in a setup phase and restart the clock
+static void
+PhaseDone (SystemWallClockMs &clock, const char *phase)
+{
+  int64_t ms = clock.End();
+  if (g_timing) {
+    // plain stdout: logging is compiled out of the optimized builds that
+    // timings are taken from
+    std::cout << "timing: phase=" << phase << " wall_ms=" << ms << std::endl;
+  }
+  clock.Start();
+}
+
+// Where a generated topology is cached: the file is named by a digest of
+// everything the generator's output depends on, so a changed parameter
+// never picks up a stale graph.  Bump the version when a generator
+// changes what it produces.
+static std::string
+TopologyCacheFile (const std::string &dir, const std::string &family,
+                   uint32_t num_nodes, uint32_t degree, uint32_t grid_width,
+                   double rewire, double radius, bool connect,
+                   uint32_t graph_seed)
+{
+  std::ostringstream key;
+  key.precision(17);
+  key << "dmc-topology-v1 family=" << family << " nodes=" << num_nodes <<
+    " degree=" << degree << " width=" << grid_width << " rewire=" << rewire <<
+    " radius=" << radius << " connect=" << connect << " seed=" << graph_seed;
+  std::string s = key.str();
+  uint64_t h = 14695981039346656037ULL;
+  for(uint32_t i=0; i<s.size(); i++) {
+    h ^= (uint8_t)s[i];
+    h *= 1099511628211ULL;
+  }
+  char name[32];
+  snprintf(name, sizeof(name), "topology-%016llx.edges", (unsigned long long)h);
+  return dir + "/" + name;
+}
+
+// Installs a point-to-point link for each edge as the topology hands
+// them out, and records the edge list for the apps, churn and
+// checkpoints.  The edge list order is the link install order.
+struct LinkInstaller {
+  void Add(uint32_t a, uint32_t b);
+  void AddLink(uint32_t a, uint32_t b, DataRate link_rate, Time link_delay,
+               double link_loss);
+
+  NodeContainer nodes;
+  PointToPointHelper pointToPoint;
+  Ipv4AddressHelper address;
+  bool use_ip;
+  uint32_t num_networks;
+  NetDeviceContainer devices;
+  Ipv4InterfaceContainer interfaces;
+  GossipCheckpoint::EdgeList edges;
+  GossipLinkModel model; // for links added without their own parameters
+  std::vector<DataRate> rates;
+  std::vector<Time> delays;
+  std::vector<double> losses;
+};
+
+void
+LinkInstaller::Add(uint32_t a, uint32_t b)
+{
+  DataRate link_rate;
+  Time link_delay;
+  double link_loss;
+  model.Draw(&link_rate, &link_delay, &link_loss);
+  AddLink(a, b, link_rate, link_delay, link_loss);
+}
+
+void
+LinkInstaller::AddLink(uint32_t a, uint32_t b, DataRate link_rate,
+                       Time link_delay, double link_loss)
+{
+  edges.push_back(std::make_pair(a, b));
+  rates.push_back(link_rate);
+  delays.push_back(link_delay);
+  losses.push_back(link_loss);
+  pointToPoint.SetDeviceAttribute("DataRate", DataRateValue(link_rate));
+  pointToPoint.SetChannelAttribute("Delay", TimeValue(link_delay));
+  NodeContainer endpoints;
+  endpoints.Add(nodes.Get(a));
+  endpoints.Add(nodes.Get(b));
+
+  NetDeviceContainer ndc = pointToPoint.Install(endpoints);
+  devices.Add(ndc);
+  // lossless links, the common case, skip the error model entirely
+  if (link_loss > 0) {
+    for(uint32_t side=0; side<2; side++) {
+      DynamicCast<PointToPointNetDevice>(ndc.Get(side))->
+        SetReceiveErrorModel(GossipLinkModel::CreateErrorModel(link_loss));
+    }
+  }
+  if (!use_ip) return;
+
+  Ipv4Address network((num_networks << 3) | 0x0a000000);
+
+  Ipv4Mask mask(0xfffffff8);
+
+  NS_LOG_INFO("num_networks=" << num_networks <<
+               " network=" << network <<
+               " mask=" << mask);
+
+  address.SetBase(network, mask);
+
+  interfaces.Add(address.Assign(ndc));
+  num_networks++;
+}
+
+// Write under a temporary name and rename, so that concurrent runs
+// sharing a cache never load a partial file.  Without the link
+// parameters, loading the file draws them from the link model again.
+static void
+SaveTopology (const std::string &file, uint32_t num_nodes,
+              const LinkInstaller &links, bool with_params)
+{
+  std::ostringstream tmp;
+  tmp << file << ".tmp" << getpid();
+  std::vector<DataRate> no_rates;
+  std::vector<Time> no_delays;
+  std::vector<double> no_losses;
+  GossipEdgeFile::Save(tmp.str(), num_nodes, links.edges,
+                       with_params ? links.rates : no_rates,
+                       with_params ? links.delays : no_delays,
+                       with_params ? links.losses : no_losses);
+  NS_ABORT_MSG_IF(rename(tmp.str().c_str(), file.c_str()) != 0,
+                  "can't write topology " << file);
+}
+
 int
 main (int argc, char *argv[])
 {
   uint32_t num_nodes = 2;
   uint32_t branch_factor = 3;
+  std::string topology = "random";
+  uint32_t grid_width = 0;
+  double rewire = 0.1;
+  double radius = 0;
+  bool connect = true;
   uint32_t secs_to_run = 10;
   bool d3_output = false;
-
-  srand(time(NULL));
+  bool single_socket = false;
+  std::string transport = "Udp";
+  double ideal_loss = 0.0;
+  std::string stack_profile = "full";
+  double checkpoint_at = -1;
+  std::string checkpoint_file = "dmc.snap";
+  std::string restore_file;
+  std::string topology_file;
+  std::string topology_save;
+  std::string topology_cache;
+  uint32_t seed = 0;
+  uint32_t graph_seed = 0;
+  uint32_t ensemble = 1;
+  std::string link_rate;
+  std::string link_delay;
+  std::string link_loss;
+  uint32_t ensemble_jobs = 0;
+  std::string churn_trace;
+  double churn_rate = 0;
+  double churn_node_fraction = 0.2;
+  double churn_downtime = 5.0;
+  double churn_start = 5.0;
+  double peer_timeout = 0;
+  std::string start_mode = "fixed";
+  double start_window = 10.0;
+  uint32_t start_seed = 0;
+  double start_per_hop = 0.5;
+  double start_jitter = 0.1;
+  double start_rate = 10.0;
+  std::string scheduler;
+  bool scheduler_stats = false;
+  double check_hierarchy = 0;
+  std::string metrics_file;
+  double metrics_interval = 0;
+  std::string aggregate = "median";
+  double trim_fraction = 0.1;
+  uint32_t mtu = 1500;
+  uint32_t max_segments = 64;
+  uint32_t segment_gap = 100;
+  std::string segment_priority = "level";
 
   CommandLine cmd;
   cmd.AddValue("numNodes", "number of nodes to create", num_nodes);
   cmd.AddValue("branchFactor", "approximate num connections per node", 
                branch_factor);
+  cmd.AddValue("topology", "graph family: random, grid, torus, ba "
+               "(Barabasi-Albert), ws (Watts-Strogatz) or geometric",
+               topology);
+  cmd.AddValue("topologyFile", "edge-list file to load instead of "
+               "generating a topology: text lines of \"a b [rate [delay "
+               "[loss]]]\" (bare rates in Mbps, delays in ms) or a binary "
+               "file from topologySave", topology_file);
+  cmd.AddValue("topologySave", "binary edge-list file to write the "
+               "topology to, for quick reloading", topology_save);
+  cmd.AddValue("topologyCache", "directory of generated topologies to reuse "
+               "across runs with the same parameters; needs graphSeed",
+               topology_cache);
+  cmd.AddValue("seed", "seed of the generator the protocols draw from; 0 "
+               "for the time", seed);
+  cmd.AddValue("graphSeed", "separate seed for generating the topology, "
+               "so it stays fixed while seed varies; 0 to draw it from "
+               "seed", graph_seed);
+  cmd.AddValue("ensemble", "number of runs forked from one built network, "
+               "each with its own seed", ensemble);
+  cmd.AddValue("ensembleJobs", "most ensemble runs at once; 0 for all",
+               ensemble_jobs);
+  cmd.AddValue("linkRate", "link data rate in Mbps: a number or a random "
+               "variable such as ns3::UniformRandomVariable[Min=1|Max=10]; "
+               "default 5", link_rate);
+  cmd.AddValue("linkDelay", "link delay in ms, as for linkRate; default 2",
+               link_delay);
+  cmd.AddValue("linkLoss", "probability a link drops a packet, as for "
+               "linkRate; default 0", link_loss);
+  cmd.AddValue("gridWidth", "nodes per row of a grid or torus; 0 for "
+               "square", grid_width);
+  cmd.AddValue("rewire", "probability a Watts-Strogatz edge is rewired",
+               rewire);
+  cmd.AddValue("radius", "link range of the geometric graph in the unit "
+               "square; 0 to match branchFactor", radius);
+  cmd.AddValue("connect", "join components the graph family left "
+               "disconnected", connect);
   cmd.AddValue("secsToRun", "number of seconds to simulate", secs_to_run);
   cmd.AddValue("d3", "emit d3-friendly JSON", d3_output);
+  cmd.AddValue("singleSocket", "use one unconnected socket per node",
+               single_socket);
+  cmd.AddValue("transport", "gossip transport: Udp, Raw or Ideal", transport);
+  cmd.AddValue("idealLoss", "message loss rate of the Ideal transport",
+               ideal_loss);
+  cmd.AddValue("stackProfile", "internet stack for the Udp transport: full "
+               "(IPv4+IPv6, global routing) or lean (IPv4, static routes)",
+               stack_profile);
+  cmd.AddValue("timing", "report wall-clock time of each setup phase",
+               g_timing);
+  cmd.AddValue("checkpointAt", "seconds after start to write a snapshot",
+               checkpoint_at);
+  cmd.AddValue("checkpointFile", "snapshot file to write", checkpoint_file);
+  cmd.AddValue("restoreFrom", "snapshot file to resume from; replaces the "
+               "generated topology", restore_file);
+  cmd.AddValue("churnTrace", "file of scheduled link/node failures and "
+               "recoveries", churn_trace);
+  cmd.AddValue("churnRate", "random failures per second", churn_rate);
+  cmd.AddValue("churnNodeFraction", "fraction of random failures that take "
+               "out a node instead of a link", churn_node_fraction);
+  cmd.AddValue("churnDowntime", "mean seconds until a failure recovers",
+               churn_downtime);
+  cmd.AddValue("churnStart", "seconds after start before random failures "
+               "begin", churn_start);
+  cmd.AddValue("peerTimeout", "seconds of silence before a neighbor is "
+               "expired; 0 disables expiry", peer_timeout);
+  cmd.AddValue("startMode", "how node start times are spread: fixed (all "
+               "at once), uniform, wave or poisson", start_mode);
+  cmd.AddValue("startWindow", "seconds over which uniform starts are spread",
+               start_window);
+  cmd.AddValue("startSeed", "node the wave starts from", start_seed);
+  cmd.AddValue("startPerHop", "seconds between wave fronts", start_per_hop);
+  cmd.AddValue("startJitter", "random extra seconds added to wave starts",
+               start_jitter);
+  cmd.AddValue("startRate", "poisson node arrivals per second", start_rate);
+  cmd.AddValue("scheduler", "event queue: Map, Heap, List, Calendar or "
+               "Bucket (default: the ns-3 default)", scheduler);
+  cmd.AddValue("schedulerStats", "report event counts, events/s and peak "
+               "memory after the run", scheduler_stats);
+  cmd.AddValue("checkHierarchy", "seconds between checks of the hierarchy "
+               "invariants; 0 disables checking", check_hierarchy);
+  cmd.AddValue("metricsFile", "CSV file to append hierarchy metrics to",
+               metrics_file);
+  cmd.AddValue("metricsInterval", "seconds between metrics samples; 0 "
+               "samples only at the end", metrics_interval);
+  cmd.AddValue("aggregate", "how reps combine group values: median, "
+               "trimmed (mean) or weighted (median)", aggregate);
+  cmd.AddValue("trimFraction", "fraction trimmed from each end by the "
+               "trimmed aggregate", trim_fraction);
+  cmd.AddValue("mtu", "largest gossip packet, headers included; bigger "
+               "messages are split into segments", mtu);
+  cmd.AddValue("maxSegments", "most segments a message may take before it "
+               "is dropped instead of sent", max_segments);
+  cmd.AddValue("segmentGap", "microseconds between the segments of a "
+               "message", segment_gap);
+  cmd.AddValue("segmentPriority", "which segments of a split message go "
+               "first: level (lowest first) or recency (latest change "
+               "first)", segment_priority);
   cmd.Parse (argc, argv);
 
+  uint32_t run_seed = seed ? seed : time(NULL);
+  GossipCheckpoint::InitRandomState(run_seed);
+
+  if (!scheduler.empty() || scheduler_stats) {
+    std::string type = "ns3::" + (scheduler.empty() ? "Map" : scheduler) +
+      "Scheduler";
+    ObjectFactory sched;
+    if (scheduler_stats) {
+      sched.SetTypeId("ns3::CountingScheduler");
+      sched.Set("Inner", StringValue(type));
+    } else {
+      sched.SetTypeId(type);
+    }
+    Simulator::SetScheduler(sched);
+  }
+
+  SystemWallClockMs clock;
+  clock.Start();
+
   if (d3_output) {
     NS_LOG_INFO("D3 var nodes = [];");
     NS_LOG_INFO("D3 var links = [];");
@@ -55,85 +350,273 @@ main (int argc, char *argv[])
   LogComponentEnable ("UdpGossipApplication", LOG_LEVEL_INFO);
   LogComponentEnable ("LubyMISProtocol", LOG_LEVEL_INFO);
 
-  NodeContainer nodes;
-  nodes.Create (num_nodes);
-
-  bool cxns[num_nodes][num_nodes];
-  for(uint32_t i=0; i<num_nodes; i++) {
-    for(uint32_t j=0; j<num_nodes; j++) {
-      cxns[i][j] = false;
+  GossipCheckpoint snapshot;
+  GossipEdgeFile *edge_file = 0;
+  std::string cache_save;
+  if (!restore_file.empty()) {
+    snapshot.Load(restore_file);
+    num_nodes = snapshot.GetNumNodes();
+  } else if (!topology_file.empty()) {
+    edge_file = new GossipEdgeFile(topology_file);
+  } else if (!topology_cache.empty()) {
+    NS_ABORT_MSG_IF(graph_seed == 0, "topologyCache needs a graphSeed");
+    topology_file = TopologyCacheFile(topology_cache, topology, num_nodes,
+                                      branch_factor, grid_width, rewire,
+                                      radius, connect, graph_seed);
+    if (access(topology_file.c_str(), R_OK) == 0) {
+      edge_file = new GossipEdgeFile(topology_file);
+    } else {
+      // generate it below and save it here
+      cache_save = topology_file;
     }
   }
+  if (edge_file) {
+    num_nodes = edge_file->GetNumNodes();
+  }
 
-  // make sure we have a connected graph
-  uint32_t total_edges = 0;
-  for(uint32_t i=1; i<num_nodes; i++) {
-    // choose someone that already exists
-    uint32_t j = rand() % i;
-    cxns[i][j] = true;
-    cxns[j][i] = true;
-    NS_LOG_DEBUG("initial connectivity: connecting " << i << " to " << j);
-    total_edges++;
-  }
-
-  uint32_t target_edges = num_nodes * branch_factor / 2;
-  uint32_t max_edges = num_nodes * (num_nodes - 1) / 2;
-  if (target_edges > max_edges) target_edges = max_edges;
-  while(total_edges < target_edges) {
-    uint32_t i = rand() % num_nodes;
-    uint32_t j = rand() % num_nodes;
-    if (i != j && !cxns[i][j]) {
-      cxns[i][j] = cxns[j][i] = true;
-      NS_LOG_DEBUG("extra connectivity: connecting " << i << " to " << j);
-      total_edges++;
+  LinkInstaller links;
+  NodeContainer &nodes = links.nodes;
+  nodes.Create (num_nodes);
+
+  PhaseDone(clock, "nodes");
+
+  // the raw and ideal transports run without an internet stack
+  bool use_ip = (transport == "Udp");
+  links.use_ip = use_ip;
+  if (use_ip) {
+    InternetStackHelper stack;
+    if (stack_profile == "lean") {
+      // gossip only talks to directly connected peers, and assigning an
+      // address gives static routing the route to that /29; nothing
+      // needs IPv6 or the global route computation
+      Ipv4StaticRoutingHelper staticRouting;
+      stack.SetRoutingHelper(staticRouting);
+      stack.SetIpv6StackInstall(false);
+    } else if (stack_profile != "full") {
+      NS_FATAL_ERROR("unknown stack profile " << stack_profile);
     }
+    stack.Install(nodes);
   }
+  PhaseDone(clock, "stack");
 
-  InternetStackHelper stack;
-  stack.Install(nodes);
-
-  NetDeviceContainer devices;
-  uint32_t num_networks = 1;
-  // establish point-to-point links
-  for(uint32_t i=0; i<num_nodes; i++) {
-    for(uint32_t j=i+1; j<num_nodes; j++) {
-      if (cxns[i][j]) {
-        PointToPointHelper pointToPoint;
-        pointToPoint.SetDeviceAttribute ("DataRate", StringValue ("5Mbps"));
-        pointToPoint.SetChannelAttribute ("Delay", StringValue ("2ms"));
-
-        NodeContainer endpoints;
-        endpoints.Add(nodes.Get(i));
-        endpoints.Add(nodes.Get(j));
-        
-        NetDeviceContainer ndc = pointToPoint.Install(endpoints);
-
-        Ipv4AddressHelper address;
-        Ipv4Address network((num_networks << 3) | 0x0a000000);
-
-        Ipv4Mask mask(0xfffffff8);
-
-        NS_LOG_INFO("num_networks=" << num_networks <<
-                     " network=" << network <<
-                     " mask=" << mask);
-
-        address.SetBase(network, mask);
-
-        address.Assign(ndc);
-        num_networks++;
+  if (!link_rate.empty()) {
+    links.model.SetRate(GossipLinkModel::Parse(link_rate));
+  }
+  if (!link_delay.empty()) {
+    links.model.SetDelay(GossipLinkModel::Parse(link_delay));
+  }
+  if (!link_loss.empty()) {
+    links.model.SetLoss(GossipLinkModel::Parse(link_loss));
+  }
+  links.num_networks = 1;
+  // establish point-to-point links, installing each edge as it comes out
+  // of the generator or file
+  if (!restore_file.empty()) {
+    const GossipCheckpoint::EdgeList &saved = snapshot.GetEdges();
+    const GossipCheckpoint::LinkParams &params = snapshot.GetLinkParams();
+    for(uint32_t e=0; e<saved.size(); e++) {
+      if (params.rates.empty()) {
+        // an older snapshot; the links come from the link model again
+        links.Add(saved[e].first, saved[e].second);
+      } else {
+        links.AddLink(saved[e].first, saved[e].second, params.rates[e],
+                      params.delays[e], params.losses[e]);
       }
     }
+  } else if (edge_file) {
+    edge_file->SetLinkModel(links.model);
+    uint32_t n = edge_file->Read(MakeCallback(&LinkInstaller::AddLink, &links));
+    std::cout << "topology: file=" << topology_file <<
+      " nodes=" << num_nodes <<
+      " edges=" << n << std::endl;
+    delete edge_file;
+  } else {
+    if (graph_seed) {
+      GossipCheckpoint::InitRandomState(graph_seed);
+    }
+    GossipTopology graph(num_nodes,
+                         MakeCallback(&LinkInstaller::Add, &links));
+    if (topology == "random") {
+      graph.Random(branch_factor);
+    } else if (topology == "grid" || topology == "torus") {
+      graph.Grid(grid_width, topology == "torus");
+    } else if (topology == "ba") {
+      graph.BarabasiAlbert(branch_factor);
+    } else if (topology == "ws") {
+      graph.WattsStrogatz(branch_factor, rewire);
+    } else if (topology == "geometric") {
+      graph.Geometric(branch_factor, radius);
+    } else {
+      NS_FATAL_ERROR("unknown topology " << topology);
+    }
+    uint32_t joins = connect ? graph.Connect() : 0;
+    std::cout << "topology: family=" << topology <<
+      " nodes=" << num_nodes <<
+      " edges=" << graph.GetNumEdges() <<
+      " joins=" << joins << std::endl;
+    if (graph_seed) {
+      // leave the protocols the same draws as a run that loaded this
+      // graph from the cache
+      GossipCheckpoint::InitRandomState(run_seed);
+    }
+  }
+  const GossipCheckpoint::EdgeList &edges = links.edges;
+  if (!topology_save.empty()) {
+    SaveTopology(topology_save, num_nodes, links, true);
   }
+  if (!cache_save.empty()) {
+    // the cache key doesn't cover the link model
+    SaveTopology(cache_save, num_nodes, links, false);
+  }
+  PhaseDone(clock, "links");
 
-  DmcDataFactory* fact = new LubyMISFactory(d3_output);
-  UdpGossipHelper gossip (7777, d3_output, fact);
+  LubyMISFactory* fact = new LubyMISFactory(d3_output);
+  fact->SetPeerTimeout(Seconds(peer_timeout));
+  if (aggregate == "median") {
+    fact->SetAggregate(LubyMIS::AGGREGATE_MEDIAN, 0);
+  } else if (aggregate == "trimmed") {
+    fact->SetAggregate(LubyMIS::AGGREGATE_TRIMMED_MEAN, trim_fraction);
+  } else if (aggregate == "weighted") {
+    fact->SetAggregate(LubyMIS::AGGREGATE_WEIGHTED_MEDIAN, 0);
+  } else {
+    NS_FATAL_ERROR("unknown aggregate " << aggregate);
+  }
+  if (segment_priority == "level") {
+    fact->SetSegmentPriority(LubyMIS::SEGMENT_BY_LEVEL);
+  } else if (segment_priority == "recency") {
+    fact->SetSegmentPriority(LubyMIS::SEGMENT_BY_RECENCY);
+  } else {
+    NS_FATAL_ERROR("unknown segment priority " << segment_priority);
+  }
+  // only hooked up when asked for: observing costs a digest per update
+  HierarchyObserver *observer = 0;
+  if (check_hierarchy > 0) {
+    observer = new HierarchyObserver(fact);
+  }
+  UdpGossipAppHelper<LubyMIS> gossip (7777, d3_output, fact);
+  gossip.SetAttribute ("SingleSocket", BooleanValue (single_socket));
+  gossip.SetAttribute ("Transport", StringValue (transport));
+  gossip.SetAttribute ("IdealLossRate", DoubleValue (ideal_loss));
+  gossip.SetAttribute ("Mtu", UintegerValue (mtu));
+  gossip.SetAttribute ("MaxSegments", UintegerValue (max_segments));
+  gossip.SetAttribute ("SegmentGap", TimeValue (MicroSeconds (segment_gap)));
   ApplicationContainer apps;
-  apps.Add(gossip.Install(nodes));
+  apps.Add(gossip.Install(nodes, edges, links.devices, links.interfaces));
 
   apps.Start (Seconds (1.0));
   apps.Stop (Seconds ((secs_to_run + 1) * 1.0));
+  if (!restore_file.empty()) {
+    snapshot.RestoreApplications(apps);
+  }
+  Time run_start = Seconds (1.0);
+  Time run_end = Seconds ((secs_to_run + 1) * 1.0);
+  GossipChurn churn(apps, edges);
+  if (restore_file.empty() && start_mode != "fixed") {
+    GossipStart start(apps, edges, Seconds(secs_to_run * 1.0));
+    if (start_mode == "uniform") {
+      start.Uniform(Seconds(1.0), Seconds(start_window));
+    } else if (start_mode == "wave") {
+      start.Wave(start_seed, Seconds(1.0), Seconds(start_per_hop),
+                 Seconds(start_jitter));
+    } else if (start_mode == "poisson") {
+      start.Poisson(Seconds(1.0), start_rate);
+    } else {
+      NS_FATAL_ERROR("unknown start mode " << start_mode);
+    }
+    run_start = start.GetFirstStart();
+    run_end = std::max(run_end, start.GetLastStop());
+    std::cout << "start: mode=" << start_mode <<
+      " first_s=" << start.GetFirstStart().GetSeconds() <<
+      " last_s=" << start.GetLastStart().GetSeconds() <<
+      " end_s=" << run_end.GetSeconds() << std::endl;
+    // reported once the hierarchy settles after the last join
+    Simulator::Schedule(start.GetFirstStart(), &GossipChurn::WatchConvergence,
+                        &churn, std::string("deploy"));
+  }
+  if (!churn_trace.empty()) {
+    churn.LoadTrace(churn_trace, Seconds(1.0));
+  }
+  if (churn_rate > 0) {
+    churn.SetRandomFailures(churn_rate, churn_node_fraction,
+                            Seconds(churn_downtime),
+                            Seconds(1.0 + churn_start),
+                            Seconds(secs_to_run * 1.0));
+  }
+  // Members of an ensemble share everything built so far.  Each reseeds
+  // the generator the protocols draw from, and writes its own files.
+  if (ensemble > 1) {
+    SystemWallClockMs ensemble_clock;
+    ensemble_clock.Start();
+    GossipEnsemble runs(ensemble, ensemble_jobs);
+    uint32_t member;
+    if (!runs.Fork(&member)) {
+      std::cout << "ensemble: members=" << ensemble <<
+        " failed=" << runs.GetFailed() <<
+        " wall_ms=" << ensemble_clock.End() << std::endl;
+      Simulator::Destroy();
+      return runs.GetFailed() > 0;
+    }
+    GossipCheckpoint::InitRandomState(run_seed + member);
+    std::cout << "ensemble: seed=" << run_seed + member << std::endl;
+    std::ostringstream suffix;
+    suffix << "." << member;
+    checkpoint_file += suffix.str();
+    if (!metrics_file.empty()) {
+      metrics_file += suffix.str();
+    }
+  }
+  if (checkpoint_at >= 0) {
+    GossipCheckpoint::LinkParams params;
+    params.rates = links.rates;
+    params.delays = links.delays;
+    params.losses = links.losses;
+    Simulator::Schedule(Seconds(1.0 + checkpoint_at), &GossipCheckpoint::Save,
+                        checkpoint_file, num_nodes, edges, params, apps);
+  }
+  HierarchyMetrics *metrics = 0;
+  if (!metrics_file.empty()) {
+    metrics = new HierarchyMetrics(apps, metrics_file, run_start, run_end);
+    if (metrics_interval > 0) {
+      metrics->SetPeriodicSample(Seconds(metrics_interval));
+    }
+  }
+  if (observer) {
+    observer->SetPeriodicCheck(Seconds(check_hierarchy), run_end);
+  }
+  PhaseDone(clock, "apps");
 
+  // just after the last application stops, so that periodic checks and
+  // samples can't keep the event queue going forever
+  Simulator::Stop (run_end + MilliSeconds (1));
+  SystemWallClockMs run_clock;
+  run_clock.Start();
   Simulator::Run ();
+  int64_t run_ms = run_clock.End();
+  PhaseDone(clock, "run");
+  if (observer) {
+    std::cout << "hierarchy: final violations=" << observer->CheckAll() <<
+      std::endl;
+    delete observer;
+  }
+  if (metrics) {
+    metrics->Sample();
+    delete metrics;
+  }
+  if (scheduler_stats) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    uint64_t events = CountingScheduler::GetRemoved();
+    // plain stdout so it survives optimized builds, where logging is
+    // compiled out
+    std::cout << "scheduler: type=" <<
+      (scheduler.empty() ? "Map" : scheduler) <<
+      " events=" << events <<
+      " inserted=" << CountingScheduler::GetInserted() <<
+      " peak_queue=" << CountingScheduler::GetPeakSize() <<
+      " run_ms=" << run_ms <<
+      " events_per_s=" << (run_ms > 0 ? events * 1000 / run_ms : 0) <<
+      " peak_rss_kb=" << usage.ru_maxrss << std::endl;
+  }
   Simulator::Destroy ();
   return 0;
 }
@@ -0,0 +1,194 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+#include "ns3/log.h"
+#include "ns3/rng-seed-manager.h"
+#include "ns3/udp-gossip.h"
+#include "gossip-checkpoint.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("GossipCheckpoint");
+
+static const char SNAPSHOT_MAGIC[8] = { 'D', 'M', 'C', 'S', 'N', 'A', 'P', '2' };
+// the same without link parameters
+static const char SNAPSHOT_MAGIC_V1[8] =
+  { 'D', 'M', 'C', 'S', 'N', 'A', 'P', '1' };
+
+// rand() draws from the random() state; giving it a buffer we own lets
+// us copy the generator out and back in with setstate().
+static char g_random_state[GossipCheckpoint::RANDOM_STATE_SIZE];
+
+void
+GossipCheckpoint::InitRandomState (uint32_t seed)
+{
+  initstate (seed, g_random_state, sizeof (g_random_state));
+}
+
+void
+GossipCheckpoint::Save (std::string file, uint32_t num_nodes,
+                        const EdgeList &edges, const LinkParams &params,
+                        ApplicationContainer apps)
+{
+  NS_LOG_FUNCTION (file);
+  NS_ASSERT (params.rates.size () == edges.size () &&
+             params.delays.size () == edges.size () &&
+             params.losses.size () == edges.size ());
+  std::ofstream os (file.c_str (), std::ios::binary | std::ios::trunc);
+  NS_ABORT_MSG_IF (!os, "can't write snapshot " << file);
+
+  os.write (SNAPSHOT_MAGIC, sizeof (SNAPSHOT_MAGIC));
+  os.write ((const char *)&num_nodes, sizeof (num_nodes));
+  uint32_t num_edges = edges.size ();
+  os.write ((const char *)&num_edges, sizeof (num_edges));
+  for (uint32_t i = 0; i < num_edges; i++)
+    {
+      os.write ((const char *)&edges[i].first, sizeof (uint32_t));
+      os.write ((const char *)&edges[i].second, sizeof (uint32_t));
+      uint64_t rate = params.rates[i].GetBitRate ();
+      int64_t delay = params.delays[i].GetNanoSeconds ();
+      os.write ((const char *)&rate, sizeof (rate));
+      os.write ((const char *)&delay, sizeof (delay));
+      os.write ((const char *)&params.losses[i], sizeof (double));
+    }
+
+  // setstate on the current buffer records the generator's position in it
+  setstate (g_random_state);
+  os.write (g_random_state, sizeof (g_random_state));
+  uint32_t seed = RngSeedManager::GetSeed ();
+  uint64_t run = RngSeedManager::GetRun ();
+  os.write ((const char *)&seed, sizeof (seed));
+  os.write ((const char *)&run, sizeof (run));
+
+  uint32_t num_apps = apps.GetN ();
+  os.write ((const char *)&num_apps, sizeof (num_apps));
+  for (uint32_t i = 0; i < num_apps; i++)
+    {
+      Ptr<UdpGossip> app = DynamicCast<UdpGossip> (apps.Get (i));
+      NS_ASSERT_MSG (app != 0, "application " << i << " is not UdpGossip");
+      std::ostringstream blob;
+      app->Checkpoint (blob);
+      std::string state = blob.str ();
+      uint32_t len = state.size ();
+      os.write ((const char *)&len, sizeof (len));
+      os.write (state.data (), len);
+    }
+  NS_LOG_INFO ("wrote snapshot of " << num_apps << " applications to " << file);
+}
+
+void
+GossipCheckpoint::Load (std::string file)
+{
+  NS_LOG_FUNCTION (file);
+  std::ifstream is (file.c_str (), std::ios::binary);
+  NS_ABORT_MSG_IF (!is, "can't read snapshot " << file);
+
+  char magic[sizeof (SNAPSHOT_MAGIC)];
+  is.read (magic, sizeof (magic));
+  bool with_params = is && memcmp (magic, SNAPSHOT_MAGIC, sizeof (magic)) == 0;
+  NS_ABORT_MSG_IF (!with_params &&
+                   (!is || memcmp (magic, SNAPSHOT_MAGIC_V1,
+                                   sizeof (magic)) != 0),
+                   file << " is not a dmc snapshot");
+
+  uint32_t num_edges;
+  is.read ((char *)&m_num_nodes, sizeof (m_num_nodes));
+  is.read ((char *)&num_edges, sizeof (num_edges));
+  m_edges.resize (num_edges);
+  m_params = LinkParams ();
+  for (uint32_t i = 0; i < num_edges && is; i++)
+    {
+      is.read ((char *)&m_edges[i].first, sizeof (uint32_t));
+      is.read ((char *)&m_edges[i].second, sizeof (uint32_t));
+      if (with_params)
+        {
+          uint64_t rate;
+          int64_t delay;
+          double loss;
+          is.read ((char *)&rate, sizeof (rate));
+          is.read ((char *)&delay, sizeof (delay));
+          is.read ((char *)&loss, sizeof (loss));
+          m_params.rates.push_back (DataRate (rate));
+          m_params.delays.push_back (NanoSeconds (delay));
+          m_params.losses.push_back (loss);
+        }
+    }
+
+  is.read (m_random_state, sizeof (m_random_state));
+  uint32_t seed;
+  uint64_t run;
+  is.read ((char *)&seed, sizeof (seed));
+  is.read ((char *)&run, sizeof (run));
+  RngSeedManager::SetSeed (seed);
+  RngSeedManager::SetRun (run);
+
+  uint32_t num_apps;
+  is.read ((char *)&num_apps, sizeof (num_apps));
+  m_app_state.resize (num_apps);
+  for (uint32_t i = 0; i < num_apps && is; i++)
+    {
+      uint32_t len;
+      is.read ((char *)&len, sizeof (len));
+      m_app_state[i].resize (len);
+      is.read (&m_app_state[i][0], len);
+    }
+  NS_ABORT_MSG_IF (!is, "truncated snapshot " << file);
+}
+
+uint32_t
+GossipCheckpoint::GetNumNodes (void) const
+{
+  return m_num_nodes;
+}
+
+const GossipCheckpoint::EdgeList &
+GossipCheckpoint::GetEdges (void) const
+{
+  return m_edges;
+}
+
+const GossipCheckpoint::LinkParams &
+GossipCheckpoint::GetLinkParams (void) const
+{
+  return m_params;
+}
+
+void
+GossipCheckpoint::RestoreApplications (ApplicationContainer apps) const
+{
+  NS_LOG_FUNCTION (this);
+  NS_ABORT_MSG_IF (apps.GetN () != m_app_state.size (),
+                   "snapshot has " << m_app_state.size () <<
+                   " applications, simulation has " << apps.GetN ());
+  for (uint32_t i = 0; i < apps.GetN (); i++)
+    {
+      Ptr<UdpGossip> app = DynamicCast<UdpGossip> (apps.Get (i));
+      NS_ASSERT_MSG (app != 0, "application " << i << " is not UdpGossip");
+      std::istringstream blob (m_app_state[i]);
+      app->Restore (blob);
+    }
+
+  // only now, so that creating the applications didn't consume any draws
+  memcpy (g_random_state, m_random_state, sizeof (g_random_state));
+  setstate (g_random_state);
+}
+
+} // namespace ns3
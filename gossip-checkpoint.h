@@ -0,0 +1,118 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GOSSIP_CHECKPOINT_H
+#define GOSSIP_CHECKPOINT_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <utility>
+#include "ns3/application-container.h"
+#include "ns3/data-rate.h"
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup udpgossip
+ * \brief Snapshot of a whole gossip simulation
+ *
+ * A snapshot holds the topology as an edge list (in link installation
+ * order, so that rebuilding it reproduces the same devices and address
+ * plan) with each link's data rate, delay and loss rate, the state of
+ * the C library random number generator that the protocols draw from,
+ * the ns-3 seed and run number, and a UdpGossip::Checkpoint blob for
+ * every application.
+ *
+ * Packets in flight when the snapshot is taken are not recorded; gossip
+ * tolerates losing them.  The state of individual ns-3 random variable
+ * streams isn't recorded either.
+ */
+class GossipCheckpoint
+{
+public:
+  typedef std::vector<std::pair<uint32_t, uint32_t> > EdgeList;
+
+  /**
+   * \brief Per-link parameters, parallel to an EdgeList
+   */
+  struct LinkParams
+  {
+    std::vector<DataRate> rates;
+    std::vector<Time> delays;
+    std::vector<double> losses;
+  };
+
+  static const uint32_t RANDOM_STATE_SIZE = 256;
+
+  /**
+   * \brief Seed the C library generator with a state buffer we can save
+   *
+   * Use this instead of srand() so that Save can capture the generator.
+   */
+  static void InitRandomState (uint32_t seed);
+
+  /**
+   * \brief Write a snapshot of the running simulation to a file
+   *
+   * \param file the snapshot file to create
+   * \param num_nodes number of nodes in the topology
+   * \param edges links, in the order they were installed
+   * \param params the parameters of those links
+   * \param apps the UdpGossip applications, in node order
+   */
+  static void Save (std::string file, uint32_t num_nodes,
+                    const EdgeList &edges, const LinkParams &params,
+                    ApplicationContainer apps);
+
+  /**
+   * \brief Read a snapshot file
+   *
+   * Restores the ns-3 seed and run straight away; the topology is then
+   * available to rebuild the network before RestoreApplications.
+   */
+  void Load (std::string file);
+
+  uint32_t GetNumNodes (void) const;
+  const EdgeList &GetEdges (void) const;
+
+  /**
+   * \return the saved link parameters; empty for snapshots written
+   *         before they were recorded, whose links have to be drawn again
+   */
+  const LinkParams &GetLinkParams (void) const;
+
+  /**
+   * \brief Restore each (not yet started) application's saved state
+   *
+   * Also puts the C library generator back where it was, so this should
+   * come after everything that draws from it during setup.
+   */
+  void RestoreApplications (ApplicationContainer apps) const;
+
+private:
+  uint32_t m_num_nodes;
+  EdgeList m_edges;
+  LinkParams m_params;
+  std::vector<std::string> m_app_state; //!< UdpGossip::Checkpoint blobs
+  char m_random_state[RANDOM_STATE_SIZE];
+};
+
+} // namespace ns3
+
+#endif /* GOSSIP_CHECKPOINT_H */
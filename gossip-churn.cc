@@ -0,0 +1,354 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/udp-gossip.h"
+#include "gossip-churn.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("GossipChurn");
+
+// FNV-1a over a node's marshalled state
+static uint64_t
+StateDigest (DmcData *dd)
+{
+  uint32_t bufsz = dd->GetMarshalledSize ();
+  uint8_t *buf = new uint8_t[bufsz];
+  dd->MarshalTo (buf);
+  uint64_t h = 14695981039346656037ULL;
+  for (uint32_t i = 0; i < bufsz; i++)
+    {
+      h ^= buf[i];
+      h *= 1099511628211ULL;
+    }
+  delete [] buf;
+  return h;
+}
+
+GossipChurn::GossipChurn (ApplicationContainer apps,
+                          const GossipCheckpoint::EdgeList &edges)
+  : m_apps (apps),
+    m_adjacency (apps.GetN ()),
+    m_node_down (apps.GetN (), false),
+    m_poll (MilliSeconds (100)),
+    m_quiet (Seconds (1.0)),
+    m_polling (false),
+    m_digests (apps.GetN (), 0),
+    m_sent_at_change (0),
+    m_bytes_at_change (0),
+    m_rate (0),
+    m_node_fraction (0)
+{
+  for (uint32_t i = 0; i < edges.size (); i++)
+    {
+      Link l = MakeLink (edges[i].first, edges[i].second);
+      m_adjacency[l.first].push_back (l.second);
+      m_adjacency[l.second].push_back (l.first);
+      m_links.push_back (l);
+      m_link_set.insert (l);
+    }
+  m_exp_rv = CreateObject<ExponentialRandomVariable> ();
+  m_uni_rv = CreateObject<UniformRandomVariable> ();
+}
+
+GossipChurn::Link
+GossipChurn::MakeLink (uint32_t a, uint32_t b)
+{
+  return a < b ? std::make_pair (a, b) : std::make_pair (b, a);
+}
+
+Ptr<UdpGossip>
+GossipChurn::GetApp (uint32_t n) const
+{
+  return DynamicCast<UdpGossip> (m_apps.Get (n));
+}
+
+void
+GossipChurn::LoadTrace (std::string file, Time offset)
+{
+  NS_LOG_FUNCTION (this << file);
+  std::ifstream in (file.c_str ());
+  NS_ABORT_MSG_IF (!in, "can't read churn trace " << file);
+  std::string line;
+  uint32_t lineno = 0;
+  while (std::getline (in, line))
+    {
+      lineno++;
+      std::string::size_type hash = line.find ('#');
+      if (hash != std::string::npos)
+        {
+          line.erase (hash);
+        }
+      std::istringstream fields (line);
+      double secs;
+      std::string what;
+      uint32_t a, b;
+      if (!(fields >> secs))
+        {
+          continue;             // blank line
+        }
+      fields >> what >> a;
+      Time at = offset + Seconds (secs);
+      if (what == "link-down" && fields >> b)
+        {
+          Simulator::Schedule (at, &GossipChurn::LinkDown, this, a, b);
+        }
+      else if (what == "link-up" && fields >> b)
+        {
+          Simulator::Schedule (at, &GossipChurn::LinkUp, this, a, b);
+        }
+      else if (what == "node-down" && fields)
+        {
+          Simulator::Schedule (at, &GossipChurn::NodeDown, this, a);
+        }
+      else if (what == "node-up" && fields)
+        {
+          Simulator::Schedule (at, &GossipChurn::NodeUp, this, a);
+        }
+      else
+        {
+          NS_FATAL_ERROR (file << ":" << lineno << ": can't parse '" <<
+                          line << "'");
+        }
+    }
+}
+
+void
+GossipChurn::SetRandomFailures (double rate, double node_fraction,
+                                Time mean_downtime, Time start, Time stop)
+{
+  NS_LOG_FUNCTION (this << rate << node_fraction);
+  m_rate = rate;
+  m_node_fraction = node_fraction;
+  m_mean_downtime = mean_downtime;
+  m_stop = stop;
+  if (m_rate > 0)
+    {
+      Simulator::Schedule (start + Seconds (m_exp_rv->GetValue (1.0 / m_rate, 0)),
+                           &GossipChurn::NextRandomFailure, this);
+    }
+}
+
+void
+GossipChurn::SetConvergenceCheck (Time poll, Time quiet)
+{
+  m_poll = poll;
+  m_quiet = quiet;
+}
+
+void
+GossipChurn::NextRandomFailure (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (Simulator::Now () > m_stop)
+    {
+      return;
+    }
+  Time downtime = Seconds (m_exp_rv->GetValue (m_mean_downtime.GetSeconds (), 0));
+  if (m_uni_rv->GetValue () < m_node_fraction)
+    {
+      uint32_t n = m_uni_rv->GetInteger (0, m_apps.GetN () - 1);
+      if (!m_node_down[n])
+        {
+          NodeDown (n);
+          Simulator::Schedule (downtime, &GossipChurn::NodeUp, this, n);
+        }
+    }
+  else if (!m_links.empty ())
+    {
+      Link l = m_links[m_uni_rv->GetInteger (0, m_links.size () - 1)];
+      if (m_failed_links.count (l) == 0)
+        {
+          LinkDown (l.first, l.second);
+          Simulator::Schedule (downtime, &GossipChurn::LinkUp, this,
+                               l.first, l.second);
+        }
+    }
+  Simulator::Schedule (Seconds (m_exp_rv->GetValue (1.0 / m_rate, 0)),
+                       &GossipChurn::NextRandomFailure, this);
+}
+
+// bring the apps' view of a link in line with the link and node states
+void
+GossipChurn::ApplyLink (uint32_t a, uint32_t b)
+{
+  bool up = (m_failed_links.count (MakeLink (a, b)) == 0 &&
+             !m_node_down[a] && !m_node_down[b]);
+  GetApp (a)->SetLinkUp (b, up);
+  GetApp (b)->SetLinkUp (a, up);
+}
+
+void
+GossipChurn::LinkDown (uint32_t a, uint32_t b)
+{
+  Link l = MakeLink (a, b);
+  if (m_link_set.count (l) == 0)
+    {
+      NS_LOG_WARN ("no link between " << a << " and " << b);
+      return;
+    }
+  std::ostringstream what;
+  what << "link-down " << l.first << " " << l.second;
+  RecordEvent (what.str ());
+  m_failed_links.insert (l);
+  ApplyLink (a, b);
+}
+
+void
+GossipChurn::LinkUp (uint32_t a, uint32_t b)
+{
+  Link l = MakeLink (a, b);
+  if (m_failed_links.erase (l) == 0)
+    {
+      return;
+    }
+  std::ostringstream what;
+  what << "link-up " << l.first << " " << l.second;
+  RecordEvent (what.str ());
+  ApplyLink (a, b);
+}
+
+void
+GossipChurn::NodeDown (uint32_t n)
+{
+  if (m_node_down.at (n))
+    {
+      return;
+    }
+  std::ostringstream what;
+  what << "node-down " << n;
+  RecordEvent (what.str ());
+  m_node_down[n] = true;
+  GetApp (n)->SetNodeUp (false);
+  for (uint32_t i = 0; i < m_adjacency[n].size (); i++)
+    {
+      ApplyLink (n, m_adjacency[n][i]);
+    }
+}
+
+void
+GossipChurn::NodeUp (uint32_t n)
+{
+  if (!m_node_down.at (n))
+    {
+      return;
+    }
+  std::ostringstream what;
+  what << "node-up " << n;
+  RecordEvent (what.str ());
+  m_node_down[n] = false;
+  for (uint32_t i = 0; i < m_adjacency[n].size (); i++)
+    {
+      ApplyLink (n, m_adjacency[n][i]);
+    }
+  GetApp (n)->SetNodeUp (true);
+}
+
+void
+GossipChurn::WatchConvergence (std::string what)
+{
+  RecordEvent (what);
+}
+
+void
+GossipChurn::SnapshotDigests (bool *changed)
+{
+  uint64_t sent = 0;
+  uint64_t sent_bytes = 0;
+  for (uint32_t n = 0; n < m_apps.GetN (); n++)
+    {
+      Ptr<UdpGossip> app = GetApp (n);
+      sent += app->GetSent ();
+      sent_bytes += app->GetSentBytes ();
+      // nodes that are down or not started yet have no state to hash
+      DmcData *dd = app->GetDmcData ();
+      uint64_t digest = (m_node_down[n] || dd == 0) ? 0 : StateDigest (dd);
+      if (digest != m_digests[n])
+        {
+          m_digests[n] = digest;
+          *changed = true;
+        }
+    }
+  if (*changed)
+    {
+      m_last_change = Simulator::Now ();
+      m_sent_at_change = sent;
+      m_bytes_at_change = sent_bytes;
+    }
+}
+
+void
+GossipChurn::RecordEvent (std::string what)
+{
+  NS_LOG_FUNCTION (this << what);
+  if (!m_polling)
+    {
+      // baseline for the quiet-period check
+      bool changed = false;
+      SnapshotDigests (&changed);
+      m_polling = true;
+      Simulator::Schedule (m_poll, &GossipChurn::Poll, this);
+    }
+  PendingEvent ev;
+  ev.what = what;
+  ev.at = Simulator::Now ();
+  ev.sent = 0;
+  ev.sent_bytes = 0;
+  for (uint32_t n = 0; n < m_apps.GetN (); n++)
+    {
+      ev.sent += GetApp (n)->GetSent ();
+      ev.sent_bytes += GetApp (n)->GetSentBytes ();
+    }
+  m_pending.push_back (ev);
+}
+
+void
+GossipChurn::Poll (void)
+{
+  NS_LOG_FUNCTION (this);
+  bool changed = false;
+  SnapshotDigests (&changed);
+  if (Simulator::Now () - m_last_change < m_quiet)
+    {
+      Simulator::Schedule (m_poll, &GossipChurn::Poll, this);
+      return;
+    }
+
+  for (uint32_t i = 0; i < m_pending.size (); i++)
+    {
+      const PendingEvent &ev = m_pending[i];
+      bool moved = m_last_change > ev.at;
+      // plain stdout so results survive optimized builds
+      std::cout << "churn: event=\"" << ev.what << "\"" <<
+        " at=" << ev.at.GetSeconds () <<
+        " reconverge_s=" <<
+        (moved ? (m_last_change - ev.at).GetSeconds () : 0.0) <<
+        " msgs=" << (moved ? m_sent_at_change - ev.sent : 0) <<
+        " bytes=" <<
+        (moved ? m_bytes_at_change - ev.sent_bytes : 0) <<
+        " batched=" << m_pending.size () << std::endl;
+    }
+  m_pending.clear ();
+  m_polling = false;
+}
+
+} // namespace ns3
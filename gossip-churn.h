@@ -0,0 +1,154 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GOSSIP_CHURN_H
+#define GOSSIP_CHURN_H
+
+#include <stdint.h>
+#include <set>
+#include <string>
+#include <vector>
+#include <utility>
+#include "ns3/application-container.h"
+#include "ns3/nstime.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/gossip-checkpoint.h"
+
+namespace ns3 {
+
+class UdpGossip;
+
+/**
+ * \ingroup udpgossip
+ * \brief Schedules link and node failures and recoveries for gossip apps
+ *
+ * Events come from a trace file or from a random failure process.  Links
+ * are failed at the gossip layer: both endpoint applications stop using
+ * the link (UdpGossip::SetLinkUp) and the protocol is told the neighbor
+ * is gone.  A failed node stops sending and receiving, and rejoins with
+ * fresh protocol state.
+ *
+ * After each event the hierarchy is watched until it settles: every
+ * poll interval each running node's marshalled state is hashed, and the
+ * network counts as converged once no hash has changed for the quiet
+ * period.  For every event we then report how long re-convergence took
+ * and how many messages and bytes were sent meanwhile.  Events that
+ * land before the previous one has settled are measured together.
+ */
+class GossipChurn
+{
+public:
+  /**
+   * \param apps the UdpGossip applications, indexed by node id
+   * \param edges the physical links between them
+   */
+  GossipChurn (ApplicationContainer apps,
+               const GossipCheckpoint::EdgeList &edges);
+
+  /**
+   * \brief Schedule the events in a trace file
+   *
+   * Each line is "<seconds> link-down|link-up <a> <b>" or
+   * "<seconds> node-down|node-up <n>"; '#' starts a comment.
+   *
+   * \param file the trace file
+   * \param offset simulation time that trace time 0 corresponds to
+   */
+  void LoadTrace (std::string file, Time offset);
+
+  /**
+   * \brief Generate failures as a Poisson process
+   *
+   * \param rate failures per second across the whole network
+   * \param node_fraction fraction of failures that take a node down
+   *        rather than a single link
+   * \param mean_downtime mean of the exponential time until recovery
+   * \param start time of the first possible failure
+   * \param stop no failures are started after this time
+   */
+  void SetRandomFailures (double rate, double node_fraction,
+                          Time mean_downtime, Time start, Time stop);
+
+  /**
+   * \brief Tune the convergence check
+   *
+   * \param poll how often to hash node states while waiting to settle
+   * \param quiet how long nothing may change before we call it settled
+   */
+  void SetConvergenceCheck (Time poll, Time quiet);
+
+  void LinkDown (uint32_t a, uint32_t b);
+  void LinkUp (uint32_t a, uint32_t b);
+  void NodeDown (uint32_t n);
+  void NodeUp (uint32_t n);
+
+  /**
+   * \brief Time how long the network takes to settle from now
+   *
+   * Reported like a churn event; used e.g. to measure how long nodes
+   * joining over a window take to build the hierarchy.
+   *
+   * \param what label for the report
+   */
+  void WatchConvergence (std::string what);
+
+private:
+  struct PendingEvent
+  {
+    std::string what;
+    Time at;
+    uint64_t sent;       //!< messages sent network-wide at the event
+    uint64_t sent_bytes; //!< bytes sent network-wide at the event
+  };
+
+  typedef std::pair<uint32_t, uint32_t> Link;
+
+  static Link MakeLink (uint32_t a, uint32_t b);
+  Ptr<UdpGossip> GetApp (uint32_t n) const;
+  void ApplyLink (uint32_t a, uint32_t b);
+  void RecordEvent (std::string what);
+  void SnapshotDigests (bool *changed);
+  void Poll (void);
+  void NextRandomFailure (void);
+
+  ApplicationContainer m_apps;
+  std::vector<std::vector<uint32_t> > m_adjacency;
+  std::vector<Link> m_links;
+  std::set<Link> m_link_set;
+  std::set<Link> m_failed_links;
+  std::vector<bool> m_node_down;
+
+  Time m_poll;
+  Time m_quiet;
+  bool m_polling;
+  std::vector<uint64_t> m_digests;
+  Time m_last_change;
+  uint64_t m_sent_at_change;
+  uint64_t m_bytes_at_change;
+  std::vector<PendingEvent> m_pending;
+
+  double m_rate;
+  double m_node_fraction;
+  Time m_mean_downtime;
+  Time m_stop;
+  Ptr<ExponentialRandomVariable> m_exp_rv;
+  Ptr<UniformRandomVariable> m_uni_rv;
+};
+
+} // namespace ns3
+
+#endif /* GOSSIP_CHURN_H */
@@ -0,0 +1,466 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <tr1/unordered_set>
+#include "ns3/log.h"
+#include "gossip-edge-file.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("GossipEdgeFile");
+
+static const char EDGES_MAGIC[8] = { 'D', 'M', 'C', 'E', 'D', 'G', 'E', '1' };
+
+// magic, then node count, link count and flags
+static const size_t EDGES_HEADER_SIZE = sizeof (EDGES_MAGIC) + 3 * sizeof (uint32_t);
+
+// records carry a rate in bps and a delay in ns after the two node ids
+static const uint32_t EDGES_LINK_PARAMS = 1;
+// and then a loss rate
+static const uint32_t EDGES_LINK_LOSS = 2;
+
+GossipEdgeFile::GossipEdgeFile (std::string file)
+  : m_file (file),
+    m_data (0),
+    m_size (0),
+    m_binary (false),
+    m_num_nodes (0)
+{
+  NS_LOG_FUNCTION (this << file);
+  int fd = open (file.c_str (), O_RDONLY);
+  NS_ABORT_MSG_IF (fd < 0, "can't read topology " << file);
+  struct stat st;
+  NS_ABORT_MSG_IF (fstat (fd, &st) != 0, "can't stat topology " << file);
+  m_size = st.st_size;
+  if (m_size > 0)
+    {
+      void *data = mmap (0, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      NS_ABORT_MSG_IF (data == MAP_FAILED, "can't map topology " << file);
+      // parsing only ever moves forward
+      madvise (data, m_size, MADV_SEQUENTIAL);
+      m_data = (const char *)data;
+    }
+  close (fd);
+
+  m_binary = (m_size >= sizeof (EDGES_MAGIC) &&
+              memcmp (m_data, EDGES_MAGIC, sizeof (EDGES_MAGIC)) == 0);
+  if (m_binary)
+    {
+      NS_ABORT_MSG_IF (m_size < EDGES_HEADER_SIZE, "truncated topology " << file);
+      memcpy (&m_num_nodes, m_data + sizeof (EDGES_MAGIC), sizeof (uint32_t));
+    }
+}
+
+GossipEdgeFile::~GossipEdgeFile ()
+{
+  if (m_data)
+    {
+      munmap ((void *)m_data, m_size);
+    }
+}
+
+void
+GossipEdgeFile::SetLinkModel (const GossipLinkModel &model)
+{
+  m_link_model = model;
+}
+
+uint32_t
+GossipEdgeFile::GetNumNodes (void)
+{
+  if (m_num_nodes == 0 && !m_binary)
+    {
+      uint32_t max_id;
+      if (ReadText (LinkSink (), &max_id) > 0)
+        {
+          m_num_nodes = max_id + 1;
+        }
+    }
+  return m_num_nodes;
+}
+
+uint32_t
+GossipEdgeFile::Read (LinkSink sink)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_binary)
+    {
+      return ReadBinary (sink);
+    }
+  uint32_t max_id;
+  uint32_t links = ReadText (sink, &max_id);
+  if (links > 0)
+    {
+      m_num_nodes = max_id + 1;
+    }
+  return links;
+}
+
+// Field parsers for the text format.  Fields are [begin, end) ranges of
+// the mapped file, which isn't NUL terminated, so the C library number
+// parsers are no use here.
+
+static bool
+FieldIs (const char *begin, const char *end, const char *word)
+{
+  size_t len = strlen (word);
+  return (size_t)(end - begin) == len && memcmp (begin, word, len) == 0;
+}
+
+static bool
+ParseId (const char *begin, const char *end, uint32_t *out)
+{
+  if (begin == end)
+    {
+      return false;
+    }
+  uint64_t v = 0;
+  for (const char *p = begin; p < end; p++)
+    {
+      if (*p < '0' || *p > '9')
+        {
+          return false;
+        }
+      v = v * 10 + (*p - '0');
+      if (v > 0xfffffffeULL)
+        {
+          return false;
+        }
+    }
+  *out = v;
+  return true;
+}
+
+// a decimal number, leaving *suffix at whatever follows it
+static bool
+ParseNumber (const char *begin, const char *end, double *out,
+             const char **suffix)
+{
+  const char *p = begin;
+  double v = 0;
+  while (p < end && *p >= '0' && *p <= '9')
+    {
+      v = v * 10 + (*p++ - '0');
+    }
+  if (p < end && *p == '.')
+    {
+      double scale = 0.1;
+      for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+        {
+          v += (*p - '0') * scale;
+          scale /= 10;
+        }
+    }
+  if (p == begin)
+    {
+      return false;
+    }
+  *out = v;
+  *suffix = p;
+  return true;
+}
+
+static bool
+ParseRate (const char *begin, const char *end, DataRate *out)
+{
+  double v;
+  const char *unit;
+  if (!ParseNumber (begin, end, &v, &unit))
+    {
+      return false;
+    }
+  // bare numbers are Mbps, as for --linkRate
+  double scale;
+  if (FieldIs (unit, end, "bps"))
+    {
+      scale = 1;
+    }
+  else if (FieldIs (unit, end, "kbps") || FieldIs (unit, end, "Kbps"))
+    {
+      scale = 1e3;
+    }
+  else if (unit == end || FieldIs (unit, end, "Mbps"))
+    {
+      scale = 1e6;
+    }
+  else if (FieldIs (unit, end, "Gbps"))
+    {
+      scale = 1e9;
+    }
+  else
+    {
+      return false;
+    }
+  uint64_t bps = (uint64_t)(v * scale + 0.5);
+  if (bps == 0)
+    {
+      return false;             // a link that can never send
+    }
+  *out = DataRate (bps);
+  return true;
+}
+
+static bool
+ParseDelay (const char *begin, const char *end, Time *out)
+{
+  double v;
+  const char *unit;
+  if (!ParseNumber (begin, end, &v, &unit))
+    {
+      return false;
+    }
+  // bare numbers are ms, as for --linkDelay
+  double scale;
+  if (FieldIs (unit, end, "s"))
+    {
+      scale = 1e9;
+    }
+  else if (unit == end || FieldIs (unit, end, "ms"))
+    {
+      scale = 1e6;
+    }
+  else if (FieldIs (unit, end, "us"))
+    {
+      scale = 1e3;
+    }
+  else if (FieldIs (unit, end, "ns"))
+    {
+      scale = 1;
+    }
+  else
+    {
+      return false;
+    }
+  *out = NanoSeconds ((int64_t)(v * scale + 0.5));
+  return true;
+}
+
+static bool
+ParseLoss (const char *begin, const char *end, double *out)
+{
+  const char *rest;
+  return ParseNumber (begin, end, out, &rest) && rest == end && *out <= 1;
+}
+
+static bool
+IsSeparator (char c)
+{
+  return c == ' ' || c == '\t' || c == ',' || c == '\r';
+}
+
+// With a null sink this only finds the highest node id.
+uint32_t
+GossipEdgeFile::ReadText (LinkSink sink, uint32_t *max_id)
+{
+  bool deliver = !sink.IsNull ();
+  std::tr1::unordered_set<uint64_t> seen;
+  if (deliver)
+    {
+      // a short text line per link
+      seen.rehash (m_size / 16);
+    }
+
+  static const uint32_t MAX_FIELDS = 5;
+  const char *field_begin[MAX_FIELDS];
+  const char *field_end[MAX_FIELDS];
+  uint32_t links = 0;
+  uint32_t lineno = 0;
+  *max_id = 0;
+  const char *p = m_data;
+  const char *end = m_data + m_size;
+  while (p < end)
+    {
+      lineno++;
+      const char *eol = (const char *)memchr (p, '\n', end - p);
+      if (eol == 0)
+        {
+          eol = end;
+        }
+      const char *line = p;
+      p = eol + 1;
+
+      uint32_t num_fields = 0;
+      const char *q = line;
+      while (q < eol && *q != '#' && *q != '%')
+        {
+          if (IsSeparator (*q))
+            {
+              q++;
+              continue;
+            }
+          const char *begin = q;
+          while (q < eol && !IsSeparator (*q) && *q != '#' && *q != '%')
+            {
+              q++;
+            }
+          if (num_fields < MAX_FIELDS)
+            {
+              field_begin[num_fields] = begin;
+              field_end[num_fields] = q;
+            }
+          num_fields++;
+        }
+      if (num_fields == 0)
+        {
+          continue;             // blank line or comment
+        }
+
+      uint32_t a, b;
+      DataRate rate;
+      Time delay;
+      double loss;
+      if (num_fields < 2 || num_fields > MAX_FIELDS ||
+          !ParseId (field_begin[0], field_end[0], &a) ||
+          !ParseId (field_begin[1], field_end[1], &b) ||
+          (num_fields > 2 && !ParseRate (field_begin[2], field_end[2], &rate)) ||
+          (num_fields > 3 && !ParseDelay (field_begin[3], field_end[3], &delay)) ||
+          (num_fields > 4 && !ParseLoss (field_begin[4], field_end[4], &loss)))
+        {
+          NS_FATAL_ERROR (m_file << ":" << lineno << ": can't parse '" <<
+                          std::string (line, eol) << "'");
+        }
+      *max_id = std::max (*max_id, std::max (a, b));
+      if (a == b)
+        {
+          continue;
+        }
+      if (a > b)
+        {
+          std::swap (a, b);
+        }
+      if (deliver && !seen.insert (((uint64_t)a << 32) | b).second)
+        {
+          continue;
+        }
+      if (deliver)
+        {
+          DataRate model_rate;
+          Time model_delay;
+          double model_loss;
+          m_link_model.Draw (&model_rate, &model_delay, &model_loss);
+          sink (a, b, num_fields > 2 ? rate : model_rate,
+                num_fields > 3 ? delay : model_delay,
+                num_fields > 4 ? loss : model_loss);
+        }
+      links++;
+    }
+  NS_LOG_INFO ("read " << links << " links from " << m_file);
+  return links;
+}
+
+uint32_t
+GossipEdgeFile::ReadBinary (LinkSink sink)
+{
+  uint32_t num_links, flags;
+  memcpy (&num_links, m_data + sizeof (EDGES_MAGIC) + sizeof (uint32_t),
+          sizeof (uint32_t));
+  memcpy (&flags, m_data + sizeof (EDGES_MAGIC) + 2 * sizeof (uint32_t),
+          sizeof (uint32_t));
+  bool has_params = (flags & EDGES_LINK_PARAMS) != 0;
+  bool has_loss = has_params && (flags & EDGES_LINK_LOSS) != 0;
+  size_t record = 2 * sizeof (uint32_t) +
+    (has_params ? 2 * sizeof (uint64_t) : 0) + (has_loss ? sizeof (double) : 0);
+  NS_ABORT_MSG_IF (m_size != EDGES_HEADER_SIZE + (uint64_t)num_links * record,
+                   "truncated topology " << m_file);
+
+  const char *p = m_data + EDGES_HEADER_SIZE;
+  for (uint32_t i = 0; i < num_links; i++, p += record)
+    {
+      uint32_t ends[2];
+      memcpy (ends, p, sizeof (ends));
+      NS_ABORT_MSG_IF (ends[0] == ends[1] || ends[0] >= m_num_nodes ||
+                       ends[1] >= m_num_nodes,
+                       m_file << ": bad link " << ends[0] << " " << ends[1]);
+      DataRate rate;
+      Time delay;
+      double loss;
+      m_link_model.Draw (&rate, &delay, &loss);
+      if (has_params)
+        {
+          uint64_t bps;
+          int64_t ns;
+          memcpy (&bps, p + sizeof (ends), sizeof (bps));
+          memcpy (&ns, p + sizeof (ends) + sizeof (bps), sizeof (ns));
+          rate = DataRate (bps);
+          delay = NanoSeconds (ns);
+        }
+      if (has_loss)
+        {
+          memcpy (&loss, p + sizeof (ends) + 2 * sizeof (uint64_t),
+                  sizeof (loss));
+        }
+      sink (std::min (ends[0], ends[1]), std::max (ends[0], ends[1]),
+            rate, delay, loss);
+    }
+  NS_LOG_INFO ("read " << num_links << " links from " << m_file);
+  return num_links;
+}
+
+void
+GossipEdgeFile::Save (std::string file, uint32_t num_nodes,
+                      const GossipCheckpoint::EdgeList &edges,
+                      const std::vector<DataRate> &rates,
+                      const std::vector<Time> &delays,
+                      const std::vector<double> &losses)
+{
+  NS_LOG_FUNCTION (file);
+  NS_ASSERT_MSG (rates.size () == delays.size () &&
+                 (rates.empty () || rates.size () == edges.size ()),
+                 "expected a rate and a delay for every link, or none");
+  NS_ASSERT_MSG (losses.empty () || losses.size () == rates.size (),
+                 "expected a loss rate for every link, or none");
+  std::ofstream os (file.c_str (), std::ios::binary | std::ios::trunc);
+  NS_ABORT_MSG_IF (!os, "can't write topology " << file);
+
+  uint32_t num_links = edges.size ();
+  uint32_t flags = rates.empty () ? 0 : EDGES_LINK_PARAMS;
+  if (!losses.empty ())
+    {
+      flags |= EDGES_LINK_LOSS;
+    }
+  os.write (EDGES_MAGIC, sizeof (EDGES_MAGIC));
+  os.write ((const char *)&num_nodes, sizeof (num_nodes));
+  os.write ((const char *)&num_links, sizeof (num_links));
+  os.write ((const char *)&flags, sizeof (flags));
+  for (uint32_t i = 0; i < num_links; i++)
+    {
+      os.write ((const char *)&edges[i].first, sizeof (uint32_t));
+      os.write ((const char *)&edges[i].second, sizeof (uint32_t));
+      if (flags & EDGES_LINK_PARAMS)
+        {
+          uint64_t bps = rates[i].GetBitRate ();
+          int64_t ns = delays[i].GetNanoSeconds ();
+          os.write ((const char *)&bps, sizeof (bps));
+          os.write ((const char *)&ns, sizeof (ns));
+        }
+      if (flags & EDGES_LINK_LOSS)
+        {
+          os.write ((const char *)&losses[i], sizeof (double));
+        }
+    }
+  NS_ABORT_MSG_IF (!os, "can't write topology " << file);
+  NS_LOG_INFO ("wrote " << num_links << " links to " << file);
+}
+
+} // namespace ns3
@@ -0,0 +1,121 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GOSSIP_EDGE_FILE_H
+#define GOSSIP_EDGE_FILE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "ns3/callback.h"
+#include "ns3/data-rate.h"
+#include "ns3/nstime.h"
+#include "ns3/gossip-checkpoint.h"
+#include "ns3/gossip-link-model.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup udpgossip
+ * \brief Reads a topology from an edge-list file
+ *
+ * The file is memory-mapped and parsed in place, handing each link to a
+ * sink as it goes, so the only per-edge memory is whatever the sink
+ * keeps.  Two formats are recognized:
+ *
+ * - text: one link per line, "a b [rate [delay [loss]]]", separated by
+ *   blanks or commas.  Node ids are used as given, counting from 0.  A
+ *   rate is a positive number with an optional bps, kbps, Mbps or Gbps
+ *   suffix, a delay is a number with an optional s, ms, us or ns suffix,
+ *   and a loss is the probability of dropping a packet.  Bare rates are
+ *   Mbps and bare delays ms, the units of dmc's --linkRate and
+ *   --linkDelay.  Text after '#' or '%' is a
+ *   comment.  Self loops and repeated links, in either direction, are
+ *   dropped.
+ *
+ * - binary, as written by Save: a header giving the node and link
+ *   counts, then fixed-size records in native byte order.  Binary files
+ *   are taken to be clean already and skip the duplicate check, which
+ *   makes them the quick way to load a large graph repeatedly.
+ *
+ * Parameters a link doesn't give are drawn from the link model.
+ */
+class GossipEdgeFile
+{
+public:
+  /**
+   * Called once per link, with the lower node id first
+   */
+  typedef Callback<void, uint32_t, uint32_t, DataRate, Time, double> LinkSink;
+
+  /**
+   * \brief Map a file for reading; aborts if it can't be opened
+   */
+  GossipEdgeFile (std::string file);
+  ~GossipEdgeFile ();
+
+  /**
+   * \brief Set the model for parameters that links don't give
+   */
+  void SetLinkModel (const GossipLinkModel &model);
+
+  /**
+   * \return one more than the highest node id in the file
+   *
+   * Text files have no header, so the first call scans the whole file.
+   */
+  uint32_t GetNumNodes (void);
+
+  /**
+   * \brief Hand every link in the file to a sink, in file order
+   *
+   * \return the number of links delivered
+   */
+  uint32_t Read (LinkSink sink);
+
+  /**
+   * \brief Write links in the binary format
+   *
+   * \param rates per-link data rates, or empty to leave them out
+   * \param delays per-link delays; given exactly when rates are
+   * \param losses per-link loss rates, or empty to leave them out; only
+   *        given with rates
+   */
+  static void Save (std::string file, uint32_t num_nodes,
+                    const GossipCheckpoint::EdgeList &edges,
+                    const std::vector<DataRate> &rates,
+                    const std::vector<Time> &delays,
+                    const std::vector<double> &losses);
+
+private:
+  GossipEdgeFile (const GossipEdgeFile &);
+  GossipEdgeFile &operator= (const GossipEdgeFile &);
+
+  uint32_t ReadText (LinkSink sink, uint32_t *max_id);
+  uint32_t ReadBinary (LinkSink sink);
+
+  std::string m_file;
+  const char *m_data;
+  size_t m_size;
+  bool m_binary;
+  uint32_t m_num_nodes; //!< 0 until known
+  GossipLinkModel m_link_model;
+};
+
+} // namespace ns3
+
+#endif /* GOSSIP_EDGE_FILE_H */
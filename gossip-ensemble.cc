@@ -0,0 +1,191 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <iostream>
+#include "ns3/log.h"
+#include "gossip-ensemble.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("GossipEnsemble");
+
+GossipEnsemble::GossipEnsemble (uint32_t members, uint32_t jobs)
+  : m_members (members),
+    m_jobs (jobs),
+    m_failed (0)
+{
+}
+
+uint32_t
+GossipEnsemble::GetFailed (void) const
+{
+  return m_failed;
+}
+
+bool
+GossipEnsemble::Fork (uint32_t *member)
+{
+  NS_LOG_FUNCTION (this << m_members << m_jobs);
+  Member none;
+  none.pid = -1;
+  none.fd = -1;
+  m_running.assign (m_members, none);
+
+  // anything still buffered would be written again by every member
+  std::cout.flush ();
+  std::clog.flush ();
+  fflush (0);
+
+  uint32_t next = 0;
+  uint32_t active = 0;
+  std::vector<struct pollfd> fds;
+  std::vector<uint32_t> fd_member;
+  char buf[65536];
+  while (next < m_members || active > 0)
+    {
+      while (next < m_members && (m_jobs == 0 || active < m_jobs))
+        {
+          if (Start (next))
+            {
+              *member = next;
+              return true;
+            }
+          next++;
+          active++;
+        }
+
+      fds.clear ();
+      fd_member.clear ();
+      for (uint32_t i = 0; i < m_members; i++)
+        {
+          if (m_running[i].fd >= 0)
+            {
+              struct pollfd p;
+              p.fd = m_running[i].fd;
+              p.events = POLLIN;
+              p.revents = 0;
+              fds.push_back (p);
+              fd_member.push_back (i);
+            }
+        }
+      if (poll (&fds[0], fds.size (), -1) < 0)
+        {
+          NS_ABORT_MSG_IF (errno != EINTR, "poll failed: errno " << errno);
+          continue;
+        }
+      for (uint32_t k = 0; k < fds.size (); k++)
+        {
+          if (fds[k].revents == 0)
+            {
+              continue;
+            }
+          uint32_t i = fd_member[k];
+          ssize_t n = read (fds[k].fd, buf, sizeof (buf));
+          if (n > 0)
+            {
+              Drain (i, buf, n);
+            }
+          else if (n == 0 || errno != EINTR)
+            {
+              Finish (i);
+              active--;
+            }
+        }
+    }
+  return false;
+}
+
+// Returns true in the new member.
+bool
+GossipEnsemble::Start (uint32_t i)
+{
+  int p[2];
+  NS_ABORT_MSG_IF (pipe (p) != 0, "can't make a pipe: errno " << errno);
+  pid_t pid = fork ();
+  NS_ABORT_MSG_IF (pid < 0, "can't fork member " << i << ": errno " << errno);
+  if (pid == 0)
+    {
+      for (uint32_t j = 0; j < i; j++)
+        {
+          if (m_running[j].fd >= 0)
+            {
+              close (m_running[j].fd);
+            }
+        }
+      m_running.clear ();
+      close (p[0]);
+      dup2 (p[1], STDOUT_FILENO);
+      dup2 (p[1], STDERR_FILENO);
+      close (p[1]);
+      return true;
+    }
+  close (p[1]);
+  m_running[i].pid = pid;
+  m_running[i].fd = p[0];
+  NS_LOG_INFO ("member " << i << " is pid " << pid);
+  return false;
+}
+
+void
+GossipEnsemble::Drain (uint32_t i, const char *buf, size_t len)
+{
+  std::string &partial = m_running[i].partial;
+  partial.append (buf, len);
+  std::string::size_type start = 0;
+  std::string::size_type eol;
+  while ((eol = partial.find ('\n', start)) != std::string::npos)
+    {
+      std::cout << "member=" << i << " ";
+      std::cout.write (partial.data () + start, eol + 1 - start);
+      start = eol + 1;
+    }
+  partial.erase (0, start);
+  std::cout.flush ();
+}
+
+void
+GossipEnsemble::Finish (uint32_t i)
+{
+  Member &m = m_running[i];
+  if (!m.partial.empty ())
+    {
+      std::cout << "member=" << i << " " << m.partial << std::endl;
+      m.partial.clear ();
+    }
+  close (m.fd);
+  m.fd = -1;
+
+  int status = 0;
+  while (waitpid (m.pid, &status, 0) < 0 && errno == EINTR)
+    {
+    }
+  if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+    {
+      m_failed++;
+      std::cout << "member=" << i << " failed: " <<
+        (WIFSIGNALED (status) ? "signal " : "exit status ") <<
+        (WIFSIGNALED (status) ? WTERMSIG (status) : WEXITSTATUS (status)) <<
+        std::endl;
+    }
+}
+
+} // namespace ns3
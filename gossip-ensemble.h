@@ -0,0 +1,83 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GOSSIP_ENSEMBLE_H
+#define GOSSIP_ENSEMBLE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup udpgossip
+ * \brief Runs several members of an ensemble from one built simulation
+ *
+ * Set up the network and applications once, then call Fork.  Each
+ * member is a forked child that shares the parent's memory copy on
+ * write, so the network is neither rebuilt nor duplicated until a
+ * member writes to it.  A member's stdout and stderr go to the parent
+ * through a pipe, and the parent copies them to its stdout a line at a
+ * time, prefixed with "member=<i> ", so the merged stream can be
+ * aggregated with the usual text tools.
+ */
+class GossipEnsemble
+{
+public:
+  /**
+   * \param members number of members to run
+   * \param jobs most members to run at once; 0 runs them all at once
+   */
+  GossipEnsemble (uint32_t members, uint32_t jobs);
+
+  /**
+   * \brief Run the members
+   *
+   * \param member set to the member's index, in the member
+   * \return true in a member, which should go on to run the simulation
+   *         and exit; false in the parent once every member has exited
+   */
+  bool Fork (uint32_t *member);
+
+  /**
+   * \return how many members exited with an error or were killed
+   */
+  uint32_t GetFailed (void) const;
+
+private:
+  struct Member
+  {
+    pid_t pid;
+    int fd;             //!< read end of its output pipe, -1 once closed
+    std::string partial; //!< output after its last complete line
+  };
+
+  bool Start (uint32_t i);
+  void Drain (uint32_t i, const char *buf, size_t len);
+  void Finish (uint32_t i);
+
+  uint32_t m_members;
+  uint32_t m_jobs;
+  uint32_t m_failed;
+  std::vector<Member> m_running;
+};
+
+} // namespace ns3
+
+#endif /* GOSSIP_ENSEMBLE_H */
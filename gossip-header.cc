@@ -0,0 +1,186 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "ns3/log.h"
+#include "gossip-header.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("GossipHeader");
+
+NS_OBJECT_ENSURE_REGISTERED (GossipHeader);
+NS_OBJECT_ENSURE_REGISTERED (GossipSegmentHeader);
+
+GossipHeader::GossipHeader ()
+  : m_sender (0)
+{
+}
+
+void
+GossipHeader::SetSender (Ipv4Address sender)
+{
+  m_sender = sender.Get ();
+}
+
+Ipv4Address
+GossipHeader::GetSender (void) const
+{
+  return Ipv4Address (m_sender);
+}
+
+TypeId
+GossipHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::GossipHeader")
+    .SetParent<Header> ()
+    .AddConstructor<GossipHeader> ()
+  ;
+  return tid;
+}
+
+TypeId
+GossipHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+void
+GossipHeader::Print (std::ostream &os) const
+{
+  os << "sender=" << Ipv4Address (m_sender);
+}
+
+uint32_t
+GossipHeader::GetSerializedSize (void) const
+{
+  return sizeof (m_sender);
+}
+
+void
+GossipHeader::Serialize (Buffer::Iterator start) const
+{
+  start.WriteHtonU32 (m_sender);
+}
+
+uint32_t
+GossipHeader::Deserialize (Buffer::Iterator start)
+{
+  m_sender = start.ReadNtohU32 ();
+  return GetSerializedSize ();
+}
+
+GossipSegmentHeader::GossipSegmentHeader ()
+  : m_seq (0),
+    m_index (0),
+    m_count (1),
+    m_offset (0),
+    m_total (0)
+{
+}
+
+void
+GossipSegmentHeader::Set (uint16_t seq, uint16_t index, uint16_t count,
+                          uint32_t offset, uint32_t total)
+{
+  m_seq = seq;
+  m_index = index;
+  m_count = count;
+  m_offset = offset;
+  m_total = total;
+}
+
+uint16_t
+GossipSegmentHeader::GetSeq (void) const
+{
+  return m_seq;
+}
+
+uint16_t
+GossipSegmentHeader::GetIndex (void) const
+{
+  return m_index;
+}
+
+uint16_t
+GossipSegmentHeader::GetCount (void) const
+{
+  return m_count;
+}
+
+uint32_t
+GossipSegmentHeader::GetOffset (void) const
+{
+  return m_offset;
+}
+
+uint32_t
+GossipSegmentHeader::GetTotal (void) const
+{
+  return m_total;
+}
+
+TypeId
+GossipSegmentHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::GossipSegmentHeader")
+    .SetParent<Header> ()
+    .AddConstructor<GossipSegmentHeader> ()
+  ;
+  return tid;
+}
+
+TypeId
+GossipSegmentHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+void
+GossipSegmentHeader::Print (std::ostream &os) const
+{
+  os << "seq=" << m_seq << " index=" << m_index << " count=" << m_count <<
+    " offset=" << m_offset << " total=" << m_total;
+}
+
+uint32_t
+GossipSegmentHeader::GetSerializedSize (void) const
+{
+  return 14;
+}
+
+void
+GossipSegmentHeader::Serialize (Buffer::Iterator start) const
+{
+  start.WriteHtonU16 (m_seq);
+  start.WriteHtonU16 (m_index);
+  start.WriteHtonU16 (m_count);
+  start.WriteHtonU32 (m_offset);
+  start.WriteHtonU32 (m_total);
+}
+
+uint32_t
+GossipSegmentHeader::Deserialize (Buffer::Iterator start)
+{
+  m_seq = start.ReadNtohU16 ();
+  m_index = start.ReadNtohU16 ();
+  m_count = start.ReadNtohU16 ();
+  m_offset = start.ReadNtohU32 ();
+  m_total = start.ReadNtohU32 ();
+  return GetSerializedSize ();
+}
+
+} // namespace ns3
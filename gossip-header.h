@@ -0,0 +1,96 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GOSSIP_HEADER_H
+#define GOSSIP_HEADER_H
+
+#include "ns3/header.h"
+#include "ns3/ipv4-address.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup udpgossip
+ * \brief Minimal header for gossip frames sent without UDP/IPv4
+ *
+ * Carries only the sender's protocol address so the receiver can tell
+ * which peer a frame came from.
+ */
+class GossipHeader : public Header
+{
+public:
+  GossipHeader ();
+
+  void SetSender (Ipv4Address sender);
+  Ipv4Address GetSender (void) const;
+
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual void Print (std::ostream &os) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+
+private:
+  uint32_t m_sender; //!< sender address
+};
+
+/**
+ * \brief Places one segment of a gossip message
+ *
+ * Every gossip packet carries one, even when the message fits in a
+ * single segment.
+ */
+class GossipSegmentHeader : public Header
+{
+public:
+  GossipSegmentHeader ();
+
+  /**
+   * \param seq the sender's message number, wrapping at 2^16
+   * \param index this segment's number within the message
+   * \param count segments in the message
+   * \param offset where this segment's bytes start in the message
+   * \param total message size in bytes
+   */
+  void Set (uint16_t seq, uint16_t index, uint16_t count, uint32_t offset,
+            uint32_t total);
+  uint16_t GetSeq (void) const;
+  uint16_t GetIndex (void) const;
+  uint16_t GetCount (void) const;
+  uint32_t GetOffset (void) const;
+  uint32_t GetTotal (void) const;
+
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual void Print (std::ostream &os) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+
+private:
+  uint16_t m_seq;
+  uint16_t m_index;
+  uint16_t m_count;
+  uint32_t m_offset;
+  uint32_t m_total;
+};
+
+} // namespace ns3
+
+#endif /* GOSSIP_HEADER_H */
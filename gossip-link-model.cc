@@ -0,0 +1,96 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <algorithm>
+#include <sstream>
+#include "ns3/log.h"
+#include "ns3/double.h"
+#include "ns3/object-factory.h"
+#include "gossip-link-model.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("GossipLinkModel");
+
+GossipLinkModel::GossipLinkModel ()
+{
+}
+
+Ptr<RandomVariableStream>
+GossipLinkModel::Parse (std::string spec)
+{
+  std::istringstream number (spec);
+  double constant;
+  if (number >> constant && number.eof ())
+    {
+      Ptr<ConstantRandomVariable> rv = CreateObject<ConstantRandomVariable> ();
+      rv->SetAttribute ("Constant", DoubleValue (constant));
+      return rv;
+    }
+  std::istringstream is (spec);
+  ObjectFactory factory;
+  is >> factory;
+  NS_ABORT_MSG_IF (is.fail (), "can't parse link distribution " << spec);
+  Ptr<RandomVariableStream> rv = factory.Create<RandomVariableStream> ();
+  NS_ABORT_MSG_IF (rv == 0, spec << " is not a random variable");
+  return rv;
+}
+
+void
+GossipLinkModel::SetRate (Ptr<RandomVariableStream> mbps)
+{
+  m_rate = mbps;
+}
+
+void
+GossipLinkModel::SetDelay (Ptr<RandomVariableStream> ms)
+{
+  m_delay = ms;
+}
+
+void
+GossipLinkModel::SetLoss (Ptr<RandomVariableStream> loss)
+{
+  m_loss = loss;
+}
+
+void
+GossipLinkModel::Draw (DataRate *rate, Time *delay, double *loss) const
+{
+  double mbps = m_rate ? m_rate->GetValue () : 5.0;
+  double ms = m_delay ? m_delay->GetValue () : 2.0;
+  double p = m_loss ? m_loss->GetValue () : 0.0;
+  // at least 1kbps, so a link can't stall forever
+  *rate = DataRate ((uint64_t)(std::max (mbps, 0.001) * 1e6 + 0.5));
+  *delay = NanoSeconds ((int64_t)(std::max (ms, 0.0) * 1e6 + 0.5));
+  *loss = std::min (std::max (p, 0.0), 1.0);
+}
+
+Ptr<ErrorModel>
+GossipLinkModel::CreateErrorModel (double loss)
+{
+  if (loss <= 0)
+    {
+      return 0;
+    }
+  Ptr<RateErrorModel> em = CreateObject<RateErrorModel> ();
+  em->SetUnit (RateErrorModel::ERROR_UNIT_PACKET);
+  em->SetRate (loss);
+  return em;
+}
+
+} // namespace ns3
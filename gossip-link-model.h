@@ -0,0 +1,91 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GOSSIP_LINK_MODEL_H
+#define GOSSIP_LINK_MODEL_H
+
+#include <string>
+#include "ns3/data-rate.h"
+#include "ns3/nstime.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/error-model.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup udpgossip
+ * \brief Draws the data rate, delay and loss rate of each link
+ *
+ * Each parameter comes from its own random variable, so links can be
+ * made to differ.  Unset parameters keep the old fixed 5Mbps, 2ms
+ * lossless links.
+ */
+class GossipLinkModel
+{
+public:
+  GossipLinkModel ();
+
+  /**
+   * \brief Parse a parameter distribution
+   *
+   * \param spec a plain number for a constant, or a random variable as
+   *        an ns-3 object factory string such as
+   *        "ns3::UniformRandomVariable[Min=1|Max=10]"
+   */
+  static Ptr<RandomVariableStream> Parse (std::string spec);
+
+  /**
+   * \param mbps link data rates in Mbps
+   */
+  void SetRate (Ptr<RandomVariableStream> mbps);
+
+  /**
+   * \param ms link delays in milliseconds
+   */
+  void SetDelay (Ptr<RandomVariableStream> ms);
+
+  /**
+   * \param loss probability that a link drops a packet, in each
+   *        direction
+   */
+  void SetLoss (Ptr<RandomVariableStream> loss);
+
+  /**
+   * \brief Draw the parameters of the next link
+   *
+   * Draws are clamped to a positive rate, a delay of at least zero and
+   * a loss rate in [0, 1].
+   */
+  void Draw (DataRate *rate, Time *delay, double *loss) const;
+
+  /**
+   * \brief Make a receive error model for one end of a link
+   *
+   * \return a packet error model dropping with probability loss, or 0
+   *         for a lossless link, which needs none
+   */
+  static Ptr<ErrorModel> CreateErrorModel (double loss);
+
+private:
+  Ptr<RandomVariableStream> m_rate;  //!< Mbps, or 0 for 5Mbps
+  Ptr<RandomVariableStream> m_delay; //!< ms, or 0 for 2ms
+  Ptr<RandomVariableStream> m_loss;  //!< or 0 for lossless
+};
+
+} // namespace ns3
+
+#endif /* GOSSIP_LINK_MODEL_H */
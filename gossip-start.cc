@@ -0,0 +1,149 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <deque>
+#include "ns3/log.h"
+#include "ns3/application.h"
+#include "gossip-start.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("GossipStart");
+
+GossipStart::GossipStart (ApplicationContainer apps,
+                          const GossipCheckpoint::EdgeList &edges,
+                          Time run)
+  : m_apps (apps),
+    m_adjacency (apps.GetN ()),
+    m_assigned (false),
+    m_run (run)
+{
+  for (uint32_t i = 0; i < edges.size (); i++)
+    {
+      m_adjacency[edges[i].first].push_back (edges[i].second);
+      m_adjacency[edges[i].second].push_back (edges[i].first);
+    }
+  m_uni_rv = CreateObject<UniformRandomVariable> ();
+  m_exp_rv = CreateObject<ExponentialRandomVariable> ();
+}
+
+void
+GossipStart::SetStart (uint32_t n, Time t)
+{
+  m_apps.Get (n)->SetStartTime (t);
+  m_apps.Get (n)->SetStopTime (t + m_run);
+  if (!m_assigned || t < m_first)
+    {
+      m_first = t;
+    }
+  if (!m_assigned || t > m_last)
+    {
+      m_last = t;
+    }
+  m_assigned = true;
+}
+
+void
+GossipStart::Uniform (Time start, Time window)
+{
+  NS_LOG_FUNCTION (this << start << window);
+  for (uint32_t n = 0; n < m_apps.GetN (); n++)
+    {
+      double offset = m_uni_rv->GetValue (0, window.GetSeconds ());
+      SetStart (n, start + Seconds (offset));
+    }
+}
+
+void
+GossipStart::Wave (uint32_t seed, Time start, Time per_hop, Time jitter)
+{
+  NS_LOG_FUNCTION (this << seed << start << per_hop << jitter);
+  NS_ABORT_MSG_IF (seed >= m_apps.GetN (), "no wave seed node " << seed);
+  const uint32_t unreached = 0xffffffff;
+  std::vector<uint32_t> hops (m_apps.GetN (), unreached);
+  std::deque<uint32_t> queue;
+  hops[seed] = 0;
+  queue.push_back (seed);
+  uint32_t max_hops = 0;
+  while (!queue.empty ())
+    {
+      uint32_t n = queue.front ();
+      queue.pop_front ();
+      max_hops = hops[n];
+      for (uint32_t i = 0; i < m_adjacency[n].size (); i++)
+        {
+          uint32_t peer = m_adjacency[n][i];
+          if (hops[peer] == unreached)
+            {
+              hops[peer] = hops[n] + 1;
+              queue.push_back (peer);
+            }
+        }
+    }
+
+  for (uint32_t n = 0; n < m_apps.GetN (); n++)
+    {
+      uint32_t h = (hops[n] == unreached ? max_hops : hops[n]);
+      double offset = m_uni_rv->GetValue (0, jitter.GetSeconds ());
+      SetStart (n, start + Seconds (per_hop.GetSeconds () * h + offset));
+    }
+}
+
+void
+GossipStart::Poisson (Time start, double rate)
+{
+  NS_LOG_FUNCTION (this << start << rate);
+  NS_ABORT_MSG_IF (rate <= 0, "arrival rate must be positive");
+  // random arrival order: Fisher-Yates over the node indices
+  std::vector<uint32_t> order (m_apps.GetN ());
+  for (uint32_t n = 0; n < order.size (); n++)
+    {
+      order[n] = n;
+    }
+  for (uint32_t n = order.size (); n > 1; n--)
+    {
+      uint32_t k = m_uni_rv->GetInteger (0, n - 1);
+      std::swap (order[n - 1], order[k]);
+    }
+
+  Time t = start;
+  for (uint32_t i = 0; i < order.size (); i++)
+    {
+      SetStart (order[i], t);
+      t += Seconds (m_exp_rv->GetValue (1.0 / rate, 0));
+    }
+}
+
+Time
+GossipStart::GetFirstStart (void) const
+{
+  return m_first;
+}
+
+Time
+GossipStart::GetLastStart (void) const
+{
+  return m_last;
+}
+
+Time
+GossipStart::GetLastStop (void) const
+{
+  return m_last + m_run;
+}
+
+} // namespace ns3
@@ -0,0 +1,107 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GOSSIP_START_H
+#define GOSSIP_START_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/application-container.h"
+#include "ns3/nstime.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/gossip-checkpoint.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup udpgossip
+ * \brief Spreads the start times of gossip apps to model incremental
+ * deployment
+ *
+ * Each method overrides the start and stop time of every application;
+ * every node runs for the same length of time from its own start, so
+ * late joiners still get a full run and never start after they were
+ * due to stop.  Starting
+ * nodes over a window instead of all at once also keeps the initial
+ * burst of first sends out of the event queue.
+ */
+class GossipStart
+{
+public:
+  /**
+   * \param apps the UdpGossip applications, indexed by node id
+   * \param edges the physical links between them
+   * \param run how long each application runs once started
+   */
+  GossipStart (ApplicationContainer apps,
+               const GossipCheckpoint::EdgeList &edges, Time run);
+
+  /**
+   * \brief Start every node at a uniformly random time in
+   * [start, start + window)
+   */
+  void Uniform (Time start, Time window);
+
+  /**
+   * \brief Start nodes in a wave spreading out from one node
+   *
+   * A node starts per_hop after its closest neighbor, plus a uniformly
+   * random jitter in [0, jitter).  Nodes the seed can't reach start with
+   * the last wave.
+   *
+   * \param seed index of the node that starts first
+   */
+  void Wave (uint32_t seed, Time start, Time per_hop, Time jitter);
+
+  /**
+   * \brief Start nodes in random order as a Poisson process
+   *
+   * \param rate node arrivals per second
+   */
+  void Poisson (Time start, double rate);
+
+  /**
+   * \return the earliest start time assigned
+   */
+  Time GetFirstStart (void) const;
+
+  /**
+   * \return the latest start time assigned
+   */
+  Time GetLastStart (void) const;
+
+  /**
+   * \return the latest stop time assigned
+   */
+  Time GetLastStop (void) const;
+
+private:
+  void SetStart (uint32_t n, Time t);
+
+  ApplicationContainer m_apps;
+  std::vector<std::vector<uint32_t> > m_adjacency;
+  bool m_assigned; //!< m_first and m_last are set
+  Time m_first;
+  Time m_last;
+  Time m_run;
+  Ptr<UniformRandomVariable> m_uni_rv;
+  Ptr<ExponentialRandomVariable> m_exp_rv;
+};
+
+} // namespace ns3
+
+#endif /* GOSSIP_START_H */
@@ -0,0 +1,373 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <stdlib.h>
+#include <cmath>
+#include <algorithm>
+#include <tr1/unordered_set>
+#include "ns3/log.h"
+#include "gossip-topology.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("GossipTopology");
+
+GossipTopology::GossipTopology (uint32_t num_nodes, EdgeSink sink)
+  : m_num_nodes (num_nodes),
+    m_sink (sink),
+    m_num_edges (0),
+    m_component (num_nodes)
+{
+  for (uint32_t n = 0; n < num_nodes; n++)
+    {
+      m_component[n] = n;
+    }
+}
+
+uint64_t
+GossipTopology::Key (uint32_t a, uint32_t b)
+{
+  return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+// uniform in [0, 1)
+double
+GossipTopology::Uniform (void)
+{
+  return rand () / (RAND_MAX + 1.0);
+}
+
+uint32_t
+GossipTopology::Find (uint32_t n)
+{
+  while (m_component[n] != n)
+    {
+      m_component[n] = m_component[m_component[n]];
+      n = m_component[n];
+    }
+  return n;
+}
+
+void
+GossipTopology::AddEdge (uint32_t a, uint32_t b)
+{
+  NS_ASSERT (a != b && a < m_num_nodes && b < m_num_nodes);
+  if (a > b)
+    {
+      std::swap (a, b);
+    }
+  m_component[Find (a)] = Find (b);
+  m_num_edges++;
+  m_sink (a, b);
+}
+
+uint32_t
+GossipTopology::GetNumEdges (void) const
+{
+  return m_num_edges;
+}
+
+void
+GossipTopology::Random (uint32_t degree)
+{
+  NS_LOG_FUNCTION (this << degree);
+  uint64_t max_edges = (uint64_t)m_num_nodes * (m_num_nodes - 1) / 2;
+  uint64_t target_edges = (uint64_t)m_num_nodes * degree / 2;
+  if (target_edges > max_edges)
+    {
+      target_edges = max_edges;
+    }
+  std::tr1::unordered_set<uint64_t> present;
+  present.rehash (std::max<uint64_t> (target_edges, m_num_nodes));
+
+  // make sure we have a connected graph
+  for (uint32_t i = 1; i < m_num_nodes; i++)
+    {
+      // choose someone that already exists
+      uint32_t j = rand () % i;
+      NS_LOG_DEBUG ("initial connectivity: connecting " << i << " to " << j);
+      present.insert (Key (i, j));
+      AddEdge (i, j);
+    }
+
+  while (present.size () < target_edges)
+    {
+      uint32_t i = rand () % m_num_nodes;
+      uint32_t j = rand () % m_num_nodes;
+      if (i != j && present.insert (Key (i, j)).second)
+        {
+          NS_LOG_DEBUG ("extra connectivity: connecting " << i << " to " << j);
+          AddEdge (i, j);
+        }
+    }
+}
+
+void
+GossipTopology::Grid (uint32_t width, bool wrap)
+{
+  NS_LOG_FUNCTION (this << width << wrap);
+  if (m_num_nodes == 0)
+    {
+      return;
+    }
+  if (width == 0)
+    {
+      width = (uint32_t)std::ceil (std::sqrt ((double)m_num_nodes));
+    }
+  width = std::min (width, m_num_nodes);
+  uint32_t rows = (m_num_nodes + width - 1) / width;
+  NS_ABORT_MSG_IF (wrap && m_num_nodes % width != 0,
+                   "a torus of " << m_num_nodes << " nodes can't have rows of "
+                   << width);
+
+  // wrapping a dimension of two would repeat the edge already there
+  bool wrap_rows = wrap && width > 2;
+  bool wrap_cols = wrap && rows > 2;
+  for (uint32_t n = 0; n < m_num_nodes; n++)
+    {
+      uint32_t col = n % width;
+      if (col + 1 < width && n + 1 < m_num_nodes)
+        {
+          AddEdge (n, n + 1);
+        }
+      else if (wrap_rows)
+        {
+          AddEdge (n - col, n);
+        }
+      if (n + width < m_num_nodes)
+        {
+          AddEdge (n, n + width);
+        }
+      else if (wrap_cols)
+        {
+          AddEdge (col, n);
+        }
+    }
+}
+
+void
+GossipTopology::BarabasiAlbert (uint32_t degree)
+{
+  NS_LOG_FUNCTION (this << degree);
+  if (m_num_nodes < 2)
+    {
+      return;
+    }
+  uint32_t links = std::min (std::max (degree / 2, 1U), m_num_nodes - 1);
+  uint32_t clique = links + 1;
+
+  // every edge end, so that a uniform pick from here is a pick of a node
+  // weighted by its degree
+  std::vector<uint32_t> ends;
+  ends.reserve (2 * ((uint64_t)clique * links / 2 +
+                     (uint64_t)(m_num_nodes - clique) * links));
+  for (uint32_t i = 1; i < clique; i++)
+    {
+      for (uint32_t j = 0; j < i; j++)
+        {
+          AddEdge (j, i);
+          ends.push_back (i);
+          ends.push_back (j);
+        }
+    }
+
+  std::vector<uint32_t> targets;
+  targets.reserve (links);
+  for (uint32_t n = clique; n < m_num_nodes; n++)
+    {
+      // at least links + 1 distinct nodes are in ends, so this ends
+      targets.clear ();
+      while (targets.size () < links)
+        {
+          uint32_t t = ends[rand () % ends.size ()];
+          if (std::find (targets.begin (), targets.end (), t) == targets.end ())
+            {
+              targets.push_back (t);
+            }
+        }
+      for (uint32_t i = 0; i < links; i++)
+        {
+          AddEdge (targets[i], n);
+          ends.push_back (targets[i]);
+          ends.push_back (n);
+        }
+    }
+}
+
+void
+GossipTopology::WattsStrogatz (uint32_t degree, double rewire)
+{
+  NS_LOG_FUNCTION (this << degree << rewire);
+  uint32_t half = std::min (std::max (degree / 2, 1U), (m_num_nodes - 1) / 2);
+  if (m_num_nodes < 3 || half == 0)
+    {
+      if (m_num_nodes == 2)
+        {
+          AddEdge (0, 1);
+        }
+      return;
+    }
+
+  // The whole ring goes in first, so a rewired edge can't land on a ring
+  // edge that hasn't been handed out yet.
+  std::tr1::unordered_set<uint64_t> present;
+  present.rehash ((uint64_t)m_num_nodes * half);
+  for (uint32_t i = 0; i < m_num_nodes; i++)
+    {
+      for (uint32_t j = 1; j <= half; j++)
+        {
+          present.insert (Key (i, (i + j) % m_num_nodes));
+        }
+    }
+  std::vector<uint32_t> node_degree (m_num_nodes, 2 * half);
+
+  for (uint32_t i = 0; i < m_num_nodes; i++)
+    {
+      for (uint32_t j = 1; j <= half; j++)
+        {
+          uint32_t b = (i + j) % m_num_nodes;
+          if (Uniform () < rewire && node_degree[i] < m_num_nodes - 1)
+            {
+              uint32_t r;
+              do
+                {
+                  r = rand () % m_num_nodes;
+                }
+              while (r == i || present.count (Key (i, r)) > 0);
+              present.erase (Key (i, b));
+              present.insert (Key (i, r));
+              node_degree[b]--;
+              node_degree[r]++;
+              b = r;
+            }
+          AddEdge (i, b);
+        }
+    }
+}
+
+void
+GossipTopology::Geometric (uint32_t degree, double radius)
+{
+  NS_LOG_FUNCTION (this << degree << radius);
+  if (m_num_nodes < 2)
+    {
+      return;
+    }
+  if (radius <= 0)
+    {
+      // a disk of area pi r^2 holds degree of the other nodes on average,
+      // ignoring the loss at the edges of the square
+      radius = std::sqrt (degree / (M_PI * (m_num_nodes - 1)));
+    }
+  if (radius <= 0)
+    {
+      return;
+    }
+
+  // Bucket nodes into square cells no narrower than the radius, so each
+  // node's neighbors are in its own cell or the eight around it.  More
+  // cells than nodes would only cost memory.
+  double per_side = std::floor (1.0 / radius);
+  double max_per_side = std::ceil (std::sqrt ((double)m_num_nodes));
+  uint32_t side = (uint32_t)std::max (1.0, std::min (per_side, max_per_side));
+  uint32_t num_cells = side * side;
+
+  std::vector<double> x (m_num_nodes);
+  std::vector<double> y (m_num_nodes);
+  std::vector<uint32_t> cell (m_num_nodes);
+  std::vector<uint32_t> cell_start (num_cells + 1, 0);
+  for (uint32_t n = 0; n < m_num_nodes; n++)
+    {
+      x[n] = Uniform ();
+      y[n] = Uniform ();
+      uint32_t cx = std::min ((uint32_t)(x[n] * side), side - 1);
+      uint32_t cy = std::min ((uint32_t)(y[n] * side), side - 1);
+      cell[n] = cy * side + cx;
+      cell_start[cell[n] + 1]++;
+    }
+  for (uint32_t c = 0; c < num_cells; c++)
+    {
+      cell_start[c + 1] += cell_start[c];
+    }
+  std::vector<uint32_t> by_cell (m_num_nodes);
+  std::vector<uint32_t> fill (cell_start.begin (), cell_start.end () - 1);
+  for (uint32_t n = 0; n < m_num_nodes; n++)
+    {
+      by_cell[fill[cell[n]]++] = n;
+    }
+
+  // each pair of cells is visited once: the cell itself, then the
+  // neighbors to the right and in the row above
+  static const int dx[] = { 1, -1, 0, 1 };
+  static const int dy[] = { 0, 1, 1, 1 };
+  double r2 = radius * radius;
+  for (uint32_t c = 0; c < num_cells; c++)
+    {
+      int cx = c % side;
+      int cy = c / side;
+      for (uint32_t i = cell_start[c]; i < cell_start[c + 1]; i++)
+        {
+          uint32_t a = by_cell[i];
+          for (uint32_t j = i + 1; j < cell_start[c + 1]; j++)
+            {
+              uint32_t b = by_cell[j];
+              double ex = x[a] - x[b], ey = y[a] - y[b];
+              if (ex * ex + ey * ey < r2)
+                {
+                  AddEdge (a, b);
+                }
+            }
+          for (uint32_t k = 0; k < 4; k++)
+            {
+              int nx = cx + dx[k], ny = cy + dy[k];
+              if (nx < 0 || nx >= (int)side || ny >= (int)side)
+                {
+                  continue;
+                }
+              uint32_t nc = ny * side + nx;
+              for (uint32_t j = cell_start[nc]; j < cell_start[nc + 1]; j++)
+                {
+                  uint32_t b = by_cell[j];
+                  double ex = x[a] - x[b], ey = y[a] - y[b];
+                  if (ex * ex + ey * ey < r2)
+                    {
+                      AddEdge (a, b);
+                    }
+                }
+            }
+        }
+    }
+}
+
+uint32_t
+GossipTopology::Connect (void)
+{
+  NS_LOG_FUNCTION (this);
+  uint32_t added = 0;
+  // every node below n is connected to node 0 by the time we reach n
+  for (uint32_t n = 1; n < m_num_nodes; n++)
+    {
+      if (Find (n) != Find (0))
+        {
+          AddEdge (rand () % n, n);
+          added++;
+        }
+    }
+  return added;
+}
+
+} // namespace ns3
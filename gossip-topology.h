@@ -0,0 +1,123 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GOSSIP_TOPOLOGY_H
+#define GOSSIP_TOPOLOGY_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/callback.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup udpgossip
+ * \brief Generates physical topologies for the gossip apps
+ *
+ * Each generator hands edges (a, b), a < b, to a sink as it produces
+ * them instead of building an adjacency matrix, so the sink can install
+ * links while the graph is still being generated.  Every generator runs
+ * in O(N + E) time and memory, and none produces a self loop or a
+ * duplicate edge.
+ *
+ * Randomness comes from rand(), like the rest of the setup, so that
+ * GossipCheckpoint captures it.
+ */
+class GossipTopology
+{
+public:
+  /**
+   * Called once per edge, with the lower node index first
+   */
+  typedef Callback<void, uint32_t, uint32_t> EdgeSink;
+
+  /**
+   * \param num_nodes number of nodes, indexed from 0
+   * \param sink receives every edge generated
+   */
+  GossipTopology (uint32_t num_nodes, EdgeSink sink);
+
+  /**
+   * \brief A random tree plus extra random edges up to a mean degree
+   */
+  void Random (uint32_t degree);
+
+  /**
+   * \brief A lattice of rows of width nodes, the last one possibly short
+   *
+   * \param width nodes per row; 0 picks a square grid
+   * \param wrap join the ends of each row and column into a torus, which
+   *        needs the node count to be a multiple of the width
+   */
+  void Grid (uint32_t width, bool wrap);
+
+  /**
+   * \brief Barabási–Albert preferential attachment
+   *
+   * Starts from a clique of degree / 2 + 1 nodes; each later node links
+   * to degree / 2 distinct earlier nodes chosen in proportion to their
+   * degree, giving a scale-free degree distribution.
+   */
+  void BarabasiAlbert (uint32_t degree);
+
+  /**
+   * \brief Watts–Strogatz small world
+   *
+   * Starts from a ring where each node links to its degree / 2 nearest
+   * nodes on either side, then moves the far end of each edge to a random
+   * node with probability rewire.
+   */
+  void WattsStrogatz (uint32_t degree, double rewire);
+
+  /**
+   * \brief A unit-disk graph over nodes placed uniformly in the unit square
+   *
+   * \param radius nodes closer than this are linked; 0 picks the radius
+   *        that gives the requested mean degree
+   */
+  void Geometric (uint32_t degree, double radius);
+
+  /**
+   * \brief Join any components left by the generator
+   *
+   * Each node not yet connected to node 0 gets an edge to a random lower
+   * numbered node, as in the random tree.
+   *
+   * \return the number of edges added
+   */
+  uint32_t Connect (void);
+
+  /**
+   * \return the number of edges handed to the sink so far
+   */
+  uint32_t GetNumEdges (void) const;
+
+private:
+  void AddEdge (uint32_t a, uint32_t b);
+  uint32_t Find (uint32_t n);
+  static uint64_t Key (uint32_t a, uint32_t b);
+  static double Uniform (void);
+
+  uint32_t m_num_nodes;
+  EdgeSink m_sink;
+  uint32_t m_num_edges;
+  std::vector<uint32_t> m_component; //!< union-find parent of each node
+};
+
+} // namespace ns3
+
+#endif /* GOSSIP_TOPOLOGY_H */
@@ -0,0 +1,197 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <algorithm>
+#include <map>
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/udp-gossip.h"
+#include "ns3/luby-mis.h"
+#include "hierarchy-metrics.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("HierarchyMetrics");
+
+HierarchyMetrics::HierarchyMetrics (ApplicationContainer apps,
+                                    std::string file, Time start, Time end)
+  : m_apps (apps),
+    m_end (end),
+    m_last_sample (start),
+    m_last_sent (0),
+    m_last_sent_bytes (0)
+{
+  // restored applications have already sent messages
+  for (uint32_t i = 0; i < m_apps.GetN (); i++)
+    {
+      Ptr<UdpGossip> app = DynamicCast<UdpGossip> (m_apps.Get (i));
+      m_last_sent += app->GetSent ();
+      m_last_sent_bytes += app->GetSentBytes ();
+    }
+  m_out.open (file.c_str (), std::ios::out | std::ios::app);
+  NS_ABORT_MSG_IF (!m_out, "can't write metrics file " << file);
+  if (m_out.tellp () == 0)
+    {
+      m_out << "nodes,time_s,metric,level,value" << std::endl;
+    }
+}
+
+// nearest-rank percentile; reorders values
+double
+HierarchyMetrics::Percentile (std::vector<uint32_t> &values, double p)
+{
+  if (values.empty ())
+    {
+      return 0;
+    }
+  uint32_t rank = (uint32_t)(p * (values.size () - 1) + 0.5);
+  std::nth_element (values.begin (), values.begin () + rank, values.end ());
+  return values[rank];
+}
+
+double
+HierarchyMetrics::Mean (const std::vector<uint32_t> &values)
+{
+  if (values.empty ())
+    {
+      return 0;
+    }
+  double sum = 0;
+  for (uint32_t i = 0; i < values.size (); i++)
+    {
+      sum += values[i];
+    }
+  return sum / values.size ();
+}
+
+void
+HierarchyMetrics::Row (const char *metric, int32_t level, double value)
+{
+  m_out << m_apps.GetN () << "," << Simulator::Now ().GetSeconds () << "," <<
+    metric << "," << level << "," << value << "\n";
+}
+
+void
+HierarchyMetrics::Sample (void)
+{
+  NS_LOG_FUNCTION (this);
+  std::vector<uint32_t> depths;
+  std::vector<uint32_t> state_bytes;
+  // per level: rep -> members, and rep -> level n-1 groups under it
+  std::vector<std::map<uint32_t, uint32_t> > members;
+  std::vector<std::map<uint32_t, uint32_t> > children;
+  uint64_t sent = 0;
+  uint64_t sent_bytes = 0;
+
+  for (uint32_t i = 0; i < m_apps.GetN (); i++)
+    {
+      Ptr<UdpGossip> app = DynamicCast<UdpGossip> (m_apps.Get (i));
+      sent += app->GetSent ();
+      sent_bytes += app->GetSentBytes ();
+      LubyMIS *luby = dynamic_cast<LubyMIS*> (app->GetDmcData ());
+      if (luby == 0)
+        {
+          continue;             // not started yet
+        }
+      const std::vector<LubyLevel*> &levels = luby->GetLevels ();
+      depths.push_back (levels.size ());
+      state_bytes.push_back (luby->GetMarshalledSize ());
+      if (members.size () < levels.size ())
+        {
+          members.resize (levels.size ());
+          children.resize (levels.size ());
+        }
+      for (uint32_t n = 1; n < levels.size (); n++)
+        {
+          uint32_t rep = levels[n]->rep;
+          if (rep == 0)
+            {
+              continue;
+            }
+          members[n][rep]++;
+          if (levels[n - 1]->rep == luby->GetId ())
+            {
+              children[n][rep]++;
+            }
+        }
+    }
+
+  Row ("depth_mean", -1, Mean (depths));
+  Row ("depth_max", -1, Percentile (depths, 1.0));
+  Row ("state_bytes_mean", -1, Mean (state_bytes));
+  Row ("state_bytes_p95", -1, Percentile (state_bytes, 0.95));
+  Row ("state_bytes_max", -1, Percentile (state_bytes, 1.0));
+
+  // nothing is sent before the first start or after the last stop
+  Time now = std::max (m_last_sample, std::min (Simulator::Now (), m_end));
+  double secs = (now - m_last_sample).GetSeconds ();
+  if (secs > 0 && m_apps.GetN () > 0)
+    {
+      Row ("msgs_per_node_s", -1,
+           (sent - m_last_sent) / secs / m_apps.GetN ());
+      Row ("bytes_per_node_s", -1,
+           (sent_bytes - m_last_sent_bytes) / secs / m_apps.GetN ());
+    }
+  m_last_sample = now;
+  m_last_sent = sent;
+  m_last_sent_bytes = sent_bytes;
+
+  for (uint32_t n = 1; n < members.size (); n++)
+    {
+      std::vector<uint32_t> sizes;
+      std::vector<uint32_t> fanout;
+      std::map<uint32_t, uint32_t>::iterator it;
+      for (it = members[n].begin (); it != members[n].end (); it++)
+        {
+          sizes.push_back (it->second);
+          fanout.push_back (children[n][it->first]);
+        }
+      Row ("groups", n, sizes.size ());
+      Row ("group_size_min", n, Percentile (sizes, 0.0));
+      Row ("group_size_mean", n, Mean (sizes));
+      Row ("group_size_p50", n, Percentile (sizes, 0.5));
+      Row ("group_size_p95", n, Percentile (sizes, 0.95));
+      Row ("group_size_max", n, Percentile (sizes, 1.0));
+      Row ("fanout_mean", n, Mean (fanout));
+      Row ("fanout_max", n, Percentile (fanout, 1.0));
+    }
+  m_out.flush ();
+}
+
+void
+HierarchyMetrics::SetPeriodicSample (Time interval)
+{
+  m_interval = interval;
+  if (Simulator::Now () + m_interval < m_end)
+    {
+      Simulator::Schedule (m_interval, &HierarchyMetrics::PeriodicSample,
+                           this);
+    }
+}
+
+void
+HierarchyMetrics::PeriodicSample (void)
+{
+  Sample ();
+  if (Simulator::Now () + m_interval < m_end)
+    {
+      Simulator::Schedule (m_interval, &HierarchyMetrics::PeriodicSample,
+                           this);
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,97 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef HIERARCHY_METRICS_H
+#define HIERARCHY_METRICS_H
+
+#include <stdint.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "ns3/application-container.h"
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup udpgossip
+ * \brief Measures how the LubyMIS hierarchy scales
+ *
+ * Each sample walks every node's state and appends rows to a CSV file
+ * in long format, one value per row:
+ *
+ *   nodes,time_s,metric,level,value
+ *
+ * Network-wide metrics have level -1:
+ *  - depth_mean, depth_max: levels per node;
+ *  - state_bytes_mean, state_bytes_p95, state_bytes_max: marshalled
+ *    message size per node, i.e. the state each node gossips;
+ *  - msgs_per_node_s, bytes_per_node_s: send rate since the previous
+ *    sample, counting only the time the applications were running.
+ *
+ * Per-level metrics, for levels 1 and up:
+ *  - groups: number of level-n groups (nodes that are their own rep);
+ *  - group_size_min, _mean, _p50, _p95, _max: nodes per group;
+ *  - fanout_mean, fanout_max: level n-1 groups under each level-n rep.
+ *
+ * The file is appended to, so runs with different numbers of nodes can
+ * share it and be plotted as scaling curves against the nodes column.
+ */
+class HierarchyMetrics
+{
+public:
+  /**
+   * \param apps the UdpGossip applications running LubyMIS
+   * \param file CSV file to append to; a header is written if it's empty
+   * \param start when the first application starts
+   * \param end when the last application stops
+   *
+   * Send rates are measured from what the applications have sent so
+   * far, so messages from before a restored checkpoint aren't counted.
+   */
+  HierarchyMetrics (ApplicationContainer apps, std::string file,
+                    Time start, Time end);
+
+  /**
+   * \brief Take a sample now
+   */
+  void Sample (void);
+
+  /**
+   * \brief Take a sample every interval from now on, until just before
+   *        the end; the caller takes the last sample when the run is over
+   */
+  void SetPeriodicSample (Time interval);
+
+private:
+  void Row (const char *metric, int32_t level, double value);
+  void PeriodicSample (void);
+  static double Percentile (std::vector<uint32_t> &values, double p);
+  static double Mean (const std::vector<uint32_t> &values);
+
+  ApplicationContainer m_apps;
+  std::ofstream m_out;
+  Time m_interval;
+  Time m_end; //!< no periodic samples at or after this
+  Time m_last_sample; //!< never before the start or after the end
+  uint64_t m_last_sent;
+  uint64_t m_last_sent_bytes;
+};
+
+} // namespace ns3
+
+#endif /* HIERARCHY_METRICS_H */
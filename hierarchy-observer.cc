@@ -0,0 +1,352 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <iostream>
+#include <sstream>
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/ipv4-address.h"
+#include "hierarchy-observer.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("HierarchyObserver");
+
+HierarchyObserver::HierarchyObserver (LubyMISFactory *factory)
+  : m_last_checked (0)
+{
+  for (uint32_t i = 0; i < NUM_INVARIANTS; i++)
+    {
+      m_violations[i] = 0;
+    }
+  factory->SetChangeCallback (MakeCallback (&HierarchyObserver::NodeChanged,
+                                            this));
+}
+
+void
+HierarchyObserver::NodeChanged (LubyMIS *node)
+{
+  m_sources[node->GetId ()] = node;
+  m_dirty.insert (node->GetId ());
+}
+
+const HierarchyLevel *
+HierarchyObserver::GetLevel (uint32_t id, uint32_t n) const
+{
+  NodeMap::const_iterator it = m_nodes.find (id);
+  if (it == m_nodes.end () || it->second.levels.size () <= n)
+    {
+      return 0;
+    }
+  return &it->second.levels[n];
+}
+
+bool
+HierarchyObserver::HasPeer (const HierarchyLevel &level, uint32_t id)
+{
+  std::vector<HierarchyPeer>::const_iterator lo = level.peers.begin ();
+  std::vector<HierarchyPeer>::const_iterator hi = level.peers.end ();
+  while (lo < hi)
+    {
+      std::vector<HierarchyPeer>::const_iterator mid = lo + (hi - lo) / 2;
+      if (mid->id < id)
+        {
+          lo = mid + 1;
+        }
+      else
+        {
+          hi = mid;
+        }
+    }
+  return lo != level.peers.end () && lo->id == id;
+}
+
+// index a node's copy: who it reads from, and which levels it leads
+void
+HierarchyObserver::UpdateIndexes (uint32_t id, const HierarchyNode &node,
+                                  bool add)
+{
+  std::set<uint32_t> reads;
+  for (uint32_t n = 0; n < node.levels.size (); n++)
+    {
+      const HierarchyLevel &lvl = node.levels[n];
+      reads.insert (lvl.rep);
+      reads.insert (lvl.rep_next_hop);
+      for (uint32_t i = 0; i < lvl.peers.size (); i++)
+        {
+          reads.insert (lvl.peers[i].id);
+        }
+      if (lvl.rep == id)
+        {
+          if (m_reps_per_level.size () <= n)
+            {
+              m_reps_per_level.resize (n + 1, 0);
+            }
+          m_reps_per_level[n] += add ? 1 : -1;
+        }
+    }
+  reads.erase (0);
+  reads.erase (id);
+  for (std::set<uint32_t>::iterator it = reads.begin ();
+       it != reads.end (); it++)
+    {
+      if (add)
+        {
+          m_refs[*it].insert (id);
+        }
+      else
+        {
+          m_refs[*it].erase (id);
+        }
+    }
+}
+
+void
+HierarchyObserver::Refresh (uint32_t id)
+{
+  HierarchyNode &copy = m_nodes[id];
+  UpdateIndexes (id, copy, false);
+
+  const std::vector<LubyLevel*> &levels = m_sources[id]->GetLevels ();
+  copy.levels.resize (levels.size ());
+  for (uint32_t n = 0; n < levels.size (); n++)
+    {
+      HierarchyLevel &dst = copy.levels[n];
+      dst.rep = levels[n]->rep;
+      dst.rep_next_hop = levels[n]->rep_next_hop;
+      dst.rep_dist = levels[n]->rep_dist;
+      const LubyPeerTable &peers = levels[n]->peers;
+      dst.peers.resize (peers.size ());
+      for (uint32_t i = 0; i < peers.size (); i++)
+        {
+          dst.peers[i].id = peers.id[i];
+          dst.peers[i].next_hop = peers.next_hop[i];
+          dst.peers[i].dist = peers.dist[i];
+          dst.peers[i].degree = peers.degree[i];
+        }
+    }
+
+  UpdateIndexes (id, copy, true);
+}
+
+void
+HierarchyObserver::CountInvariants (uint32_t id, const HierarchyNode &node,
+                                    uint32_t *counts) const
+{
+  Ipv4Address me = LubyMIS::GetIpv4Address (id);
+  for (uint32_t n = 0; n < node.levels.size (); n++)
+    {
+      const HierarchyLevel &lvl = node.levels[n];
+      uint32_t max_dist = LubyLevel::MaxPeerDistance (n);
+      for (uint32_t i = 0; i < lvl.peers.size (); i++)
+        {
+          const HierarchyPeer &p = lvl.peers[i];
+          if (p.dist > max_dist || (n == 0 && p.next_hop != p.id))
+            {
+              NS_LOG_DEBUG (me << ": level " << n << " peer " <<
+                            LubyMIS::GetIpv4Address (p.id) <<
+                            " at distance " << p.dist);
+              counts[PEER_DISTANCE]++;
+            }
+        }
+
+      if (n == 0)
+        {
+          continue;
+        }
+      const HierarchyLevel &below = node.levels[n - 1];
+
+      if (lvl.rep == id)
+        {
+          if (below.rep != id)
+            {
+              NS_LOG_DEBUG (me << ": level " << n << " rep but not level " <<
+                            (n - 1) << " rep");
+              counts[REP_CONSISTENCY]++;
+            }
+          for (uint32_t i = 0; i < below.peers.size (); i++)
+            {
+              const HierarchyLevel *other = GetLevel (below.peers[i].id, n);
+              if (other != 0 && other->rep == below.peers[i].id)
+                {
+                  NS_LOG_DEBUG (me << ": level " << n << " rep next to " <<
+                                "level " << n << " rep " <<
+                                LubyMIS::GetIpv4Address (below.peers[i].id));
+                  counts[INDEPENDENCE]++;
+                }
+            }
+        }
+      else if (lvl.rep != 0)
+        {
+          const HierarchyLevel *rep = GetLevel (lvl.rep, n);
+          const HierarchyLevel *hop = GetLevel (lvl.rep_next_hop, n);
+          if (rep == 0 || rep->rep != lvl.rep ||
+              (lvl.rep != below.rep && !HasPeer (below, lvl.rep)) ||
+              !HasPeer (node.levels[0], lvl.rep_next_hop) ||
+              hop == 0 || hop->rep != lvl.rep)
+            {
+              NS_LOG_DEBUG (me << ": inconsistent level " << n << " rep " <<
+                            LubyMIS::GetIpv4Address (lvl.rep) << " via " <<
+                            LubyMIS::GetIpv4Address (lvl.rep_next_hop));
+              counts[REP_CONSISTENCY]++;
+            }
+        }
+
+      if (below.rep == id && !below.peers.empty () && lvl.rep == 0)
+        {
+          NS_LOG_DEBUG (me << ": level " << (n - 1) << " rep without a " <<
+                        "level " << n << " rep");
+          counts[MAXIMALITY]++;
+        }
+    }
+
+  // a rep with peers should have gone on to the next level
+  if (!node.levels.empty ())
+    {
+      uint32_t top = node.levels.size () - 1;
+      const HierarchyLevel &lvl = node.levels[top];
+      if (lvl.rep == id && !lvl.peers.empty ())
+        {
+          NS_LOG_DEBUG (me << ": level " << top << " rep without a " <<
+                        "level " << (top + 1));
+          counts[MAXIMALITY]++;
+        }
+    }
+}
+
+void
+HierarchyObserver::Recheck (uint32_t id)
+{
+  std::vector<uint32_t> &mine = m_node_violations[id];
+  mine.resize (NUM_INVARIANTS, 0);
+  for (uint32_t i = 0; i < NUM_INVARIANTS; i++)
+    {
+      m_violations[i] -= mine[i];
+      mine[i] = 0;
+    }
+  NodeMap::const_iterator it = m_nodes.find (id);
+  if (it != m_nodes.end ())
+    {
+      CountInvariants (id, it->second, &mine[0]);
+    }
+  for (uint32_t i = 0; i < NUM_INVARIANTS; i++)
+    {
+      m_violations[i] += mine[i];
+    }
+}
+
+uint32_t
+HierarchyObserver::Check (void)
+{
+  NS_LOG_FUNCTION (this << m_dirty.size ());
+  std::set<uint32_t> affected;
+  for (std::set<uint32_t>::iterator it = m_dirty.begin ();
+       it != m_dirty.end (); it++)
+    {
+      Refresh (*it);
+      affected.insert (*it);
+      // nodes that read this one's state; its own reads are
+      // re-indexed by Refresh and re-checked with it
+      std::map<uint32_t, std::set<uint32_t> >::iterator refs =
+        m_refs.find (*it);
+      if (refs != m_refs.end ())
+        {
+          affected.insert (refs->second.begin (), refs->second.end ());
+        }
+    }
+  m_dirty.clear ();
+
+  for (std::set<uint32_t>::iterator it = affected.begin ();
+       it != affected.end (); it++)
+    {
+      Recheck (*it);
+    }
+  m_last_checked = affected.size ();
+
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < NUM_INVARIANTS; i++)
+    {
+      total += m_violations[i];
+    }
+  return total;
+}
+
+uint32_t
+HierarchyObserver::CheckAll (void)
+{
+  NS_LOG_FUNCTION (this);
+  for (std::map<uint32_t, LubyMIS*>::iterator it = m_sources.begin ();
+       it != m_sources.end (); it++)
+    {
+      m_dirty.insert (it->first);
+    }
+  return Check ();
+}
+
+uint32_t
+HierarchyObserver::GetViolations (Invariant which) const
+{
+  return m_violations[which];
+}
+
+const std::map<uint32_t, HierarchyNode> &
+HierarchyObserver::GetNodes (void) const
+{
+  return m_nodes;
+}
+
+void
+HierarchyObserver::SetPeriodicCheck (Time interval, Time end)
+{
+  m_interval = interval;
+  m_end = end;
+  if (Simulator::Now () + m_interval > m_end)
+    {
+      return;
+    }
+  Simulator::Schedule (m_interval, &HierarchyObserver::PeriodicCheck, this);
+}
+
+void
+HierarchyObserver::PeriodicCheck (void)
+{
+  uint32_t changed = m_dirty.size ();
+  uint32_t total = Check ();
+  std::ostringstream reps;
+  for (uint32_t n = 0; n < m_reps_per_level.size (); n++)
+    {
+      reps << (n ? "," : "") << m_reps_per_level[n];
+    }
+  // plain stdout so it survives optimized builds
+  std::cout << "hierarchy: t=" << Simulator::Now ().GetSeconds () <<
+    " nodes=" << m_nodes.size () <<
+    " changed=" << changed <<
+    " checked=" << m_last_checked <<
+    " violations=" << total <<
+    " peer_distance=" << m_violations[PEER_DISTANCE] <<
+    " rep_consistency=" << m_violations[REP_CONSISTENCY] <<
+    " independence=" << m_violations[INDEPENDENCE] <<
+    " maximality=" << m_violations[MAXIMALITY] <<
+    " reps_per_level=" << reps.str () << std::endl;
+  if (Simulator::Now () + m_interval <= m_end)
+    {
+      Simulator::Schedule (m_interval, &HierarchyObserver::PeriodicCheck,
+                           this);
+    }
+}
+
+} // namespace ns3
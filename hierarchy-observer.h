@@ -0,0 +1,163 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef HIERARCHY_OBSERVER_H
+#define HIERARCHY_OBSERVER_H
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <vector>
+#include "ns3/nstime.h"
+#include "ns3/luby-mis.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup udpgossip
+ * \brief One peer in a HierarchyObserver copy of a node's state
+ */
+struct HierarchyPeer
+{
+  uint32_t id;
+  uint32_t next_hop;
+  uint32_t dist;
+  uint32_t degree;
+};
+
+/**
+ * \ingroup udpgossip
+ * \brief One level of a node's state; peers are sorted by id
+ */
+struct HierarchyLevel
+{
+  uint32_t rep;
+  uint32_t rep_next_hop;
+  uint32_t rep_dist;
+  std::vector<HierarchyPeer> peers;
+};
+
+/**
+ * \ingroup udpgossip
+ * \brief A node's levels as last copied by a HierarchyObserver
+ */
+struct HierarchyNode
+{
+  std::vector<HierarchyLevel> levels;
+};
+
+/**
+ * \ingroup udpgossip
+ * \brief Keeps a network-wide copy of the LubyMIS hierarchy and checks
+ * its invariants
+ *
+ * The observer hooks the change callback of every LubyMIS a factory
+ * creates, so it must be constructed before the applications start.
+ * Nodes whose structure changed are only marked dirty; Check() copies
+ * their state and re-checks them and the nodes whose checks read their
+ * state, so its cost follows the amount of change rather than N.
+ *
+ * For every node x and level n the invariants are:
+ *  - peer distance: every level-n peer is at most
+ *    LubyLevel::MaxPeerDistance(n) hops away, and level-0 peers are
+ *    direct neighbors;
+ *  - rep consistency: x's level-n rep is its own level-n rep, and is
+ *    x's level n-1 rep or one of x's level n-1 peers; the next hop
+ *    towards it is a direct neighbor with the same rep;
+ *  - independence: no two level-n reps are level n-1 peers;
+ *  - maximality: a level n-1 rep with level n-1 peers has a level-n rep.
+ *
+ * Maximality and rep consistency are routinely broken while the protocol
+ * is still converging; all four should hold once it has settled.
+ */
+class HierarchyObserver
+{
+public:
+  enum Invariant
+  {
+    PEER_DISTANCE,
+    REP_CONSISTENCY,
+    INDEPENDENCE,
+    MAXIMALITY,
+    NUM_INVARIANTS
+  };
+
+  /**
+   * \param factory the factory the gossip applications create their
+   *        protocol state with
+   */
+  HierarchyObserver (LubyMISFactory *factory);
+
+  /**
+   * \brief Bring the copy up to date and re-check what changed
+   * \return the number of invariant violations in the whole network
+   */
+  uint32_t Check (void);
+
+  /**
+   * \brief Re-check every node from scratch
+   * \return the number of invariant violations in the whole network
+   */
+  uint32_t CheckAll (void);
+
+  /**
+   * \return violations of one invariant as of the last check
+   */
+  uint32_t GetViolations (Invariant which) const;
+
+  /**
+   * \brief The copied hierarchy, keyed by node id
+   *
+   * Only as fresh as the last Check().
+   */
+  const std::map<uint32_t, HierarchyNode> &GetNodes (void) const;
+
+  /**
+   * \brief Check every interval until end and report a summary line
+   *        each time
+   */
+  void SetPeriodicCheck (Time interval, Time end);
+
+private:
+  typedef std::map<uint32_t, HierarchyNode> NodeMap;
+
+  void NodeChanged (LubyMIS *node);
+  void Refresh (uint32_t id);
+  void UpdateIndexes (uint32_t id, const HierarchyNode &node, bool add);
+  void Recheck (uint32_t id);
+  void CountInvariants (uint32_t id, const HierarchyNode &node,
+                        uint32_t *counts) const;
+  const HierarchyLevel *GetLevel (uint32_t id, uint32_t n) const;
+  static bool HasPeer (const HierarchyLevel &level, uint32_t id);
+  void PeriodicCheck (void);
+
+  std::map<uint32_t, LubyMIS*> m_sources;
+  NodeMap m_nodes;
+  std::set<uint32_t> m_dirty;
+  /// id -> nodes whose checks read that id's state
+  std::map<uint32_t, std::set<uint32_t> > m_refs;
+  std::map<uint32_t, std::vector<uint32_t> > m_node_violations;
+  uint32_t m_violations[NUM_INVARIANTS];
+  std::vector<uint32_t> m_reps_per_level;
+  uint32_t m_last_checked;
+  Time m_interval;
+  Time m_end; //!< no periodic checks after this
+};
+
+} // namespace ns3
+
+#endif /* HIERARCHY_OBSERVER_H */
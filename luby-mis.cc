@@ -29,109 +29,148 @@ namespace ns3 {
   
   NS_LOG_COMPONENT_DEFINE("LubyMISProtocol");
 
+  // node id -> IPv4 address, for logging
+  static std::vector<uint32_t> g_ipv4_by_id;
+
+  // LEB128: seven bits a byte, low bits first, high bit set on all but
+  // the last byte
+  static uint32_t VarintSize(uint32_t v) {
+    uint32_t sz = 1;
+    while(v >= 0x80) {
+      v >>= 7;
+      sz++;
+    }
+    return sz;
+  }
+
+  static uint8_t* PutVarint(uint8_t *dst, uint32_t v) {
+    while(v >= 0x80) {
+      *dst++ = (uint8_t)(v | 0x80);
+      v >>= 7;
+    }
+    *dst++ = (uint8_t)v;
+    return dst;
+  }
+
+  static const uint8_t* GetVarint(const uint8_t *src, uint32_t *v) {
+    uint32_t shift = 0;
+    *v = 0;
+    while(*src & 0x80) {
+      *v |= (uint32_t)(*src++ & 0x7f) << shift;
+      shift += 7;
+    }
+    *v |= (uint32_t)(*src++) << shift;
+    return src;
+  }
+
   LubyLevel::LubyLevel() {
     rep = 0;
     rep_next_hop = 0;
     rep_dist = 0;
     rep_value = 0.0;
+    value_stale = true;
   }
 
-  LubyLevel::~LubyLevel() {
-    for(std::map<uint32_t, LubyPeer*>::iterator it = peers.begin();
-        it != peers.end(); it++) {
-      delete it->second;
-    }
+  uint32_t LubyLevel::MaxPeerDistance() {
+    return MaxPeerDistance(level);
   }
 
-  uint32_t LubyLevel::MaxPeerDistance() {
+  uint32_t LubyLevel::MaxPeerDistance(uint32_t level) {
     // 3 * 2^(n-1)
     if (level == 0) return 1;
     // 2^(n-1) == (1 << (n-1))
     return 3 * (1 << (level-1));
   }
 
-  uint32_t LubyLevel::GetMarshalledSize() {
+  uint32_t LubyLevel::GetMarshalledSize() const {
     NS_LOG_FUNCTION(this);
-    uint32_t per_peer = 4 * sizeof(uint32_t) + sizeof(double);
-    uint32_t sz = (sizeof(uint32_t) +  // level
-                   sizeof(uint32_t) +      // rep
-                   sizeof(uint32_t) +      // rep_dist
+    uint32_t sz = (VarintSize(level) +
+                   VarintSize(rep) +
+                   VarintSize(rep_dist) +
                    sizeof(double) +        // rep_value
-                   sizeof(uint32_t) +      // num peers
-                   peers.size() * per_peer); // peers
+                   VarintSize(peers.size()));
+    for(uint32_t i = 0; i < peers.size(); i++) {
+      sz += (VarintSize(peers.id[i]) +
+             VarintSize(peers.degree[i]) +
+             sizeof(double) +      // value
+             VarintSize(peers.dist[i]) +
+             VarintSize(peers.next_hop[i]));
+    }
     return sz;
   }
 
   uint8_t* LubyLevel::MarshalTo(const uint8_t *buf) {
     NS_LOG_FUNCTION(this);
     uint8_t *dst = (uint8_t *)buf;
-    memcpy(dst, &level, sizeof(level));
-    dst += sizeof(level);
-    memcpy(dst, &rep, sizeof(rep));
-    dst += sizeof(rep);
-    memcpy(dst, &rep_dist, sizeof(rep_dist));
-    dst += sizeof(rep_dist);
+    dst = PutVarint(dst, level);
+    dst = PutVarint(dst, rep);
+    dst = PutVarint(dst, rep_dist);
     memcpy(dst, &rep_value, sizeof(rep_value));
     dst += sizeof(rep_value);
-    uint32_t num_peers = peers.size();
-    memcpy(dst, &num_peers, sizeof(num_peers));
-    dst += sizeof(num_peers);
-    for(std::map<uint32_t, LubyPeer*>::iterator it = peers.begin();
-        it != peers.end(); it++) {
-      memcpy(dst, &(it->first), sizeof(it->first));
-      dst += sizeof(it->first);
-      memcpy(dst, &(it->second->degree), sizeof(it->second->degree));
-      dst += sizeof(it->second->degree);
-      memcpy(dst, &(it->second->value), sizeof(it->second->value));
-      dst += sizeof(it->second->value);
-      memcpy(dst, &(it->second->dist), sizeof(it->second->dist));
-      dst += sizeof(it->second->dist);
-      memcpy(dst, &(it->second->next_hop), sizeof(it->second->next_hop));
-      dst += sizeof(it->second->next_hop);
+    dst = PutVarint(dst, peers.size());
+    for(uint32_t i = 0; i < peers.size(); i++) {
+      dst = PutVarint(dst, peers.id[i]);
+      dst = PutVarint(dst, peers.degree[i]);
+      memcpy(dst, &peers.value[i], sizeof(double));
+      dst += sizeof(double);
+      dst = PutVarint(dst, peers.dist[i]);
+      dst = PutVarint(dst, peers.next_hop[i]);
     }
     return dst;
   }
 
-  LubyLevel* LubyLevel::MarshalFrom(const uint8_t *buf) {
-    uint8_t *src = (uint8_t *)buf;
+  LubyLevel* LubyLevel::MarshalFrom(const uint8_t *buf, uint32_t *len) {
+    const uint8_t *src = buf;
     LubyLevel* out = new LubyLevel();
-    memcpy(&out->level, src, sizeof(out->level));
-    src += sizeof(out->level);
-    memcpy(&out->rep, src, sizeof(out->rep));
-    src += sizeof(out->rep);
-    memcpy(&out->rep_dist, src, sizeof(out->rep_dist));
-    src += sizeof(out->rep_dist);
+    src = GetVarint(src, &out->level);
+    src = GetVarint(src, &out->rep);
+    src = GetVarint(src, &out->rep_dist);
     memcpy(&out->rep_value, src, sizeof(out->rep_value));
     src += sizeof(out->rep_value);
     uint32_t num_peers;
-    memcpy(&num_peers, src, sizeof(num_peers));
-    src += sizeof(num_peers);
+    src = GetVarint(src, &num_peers);
+    // peers arrive in id order
+    out->peers.reserve(num_peers);
     while(num_peers > 0) {
-      uint32_t peer_addr;
-      LubyPeer* peer = new LubyPeer();
-      memcpy(&peer_addr, src, sizeof(peer_addr));
-      src += sizeof(peer_addr);
-      memcpy(&peer->degree, src, sizeof(peer->degree));
-      src += sizeof(peer->degree);
-      memcpy(&peer->value, src, sizeof(peer->value));
-      src += sizeof(peer->value);
-      memcpy(&peer->dist, src, sizeof(peer->dist));
-      src += sizeof(peer->dist);
-      memcpy(&peer->next_hop, src, sizeof(peer->next_hop));
-      src += sizeof(peer->next_hop);
-      out->peers[peer_addr] = peer;
+      uint32_t peer_id, degree, dist, next_hop;
+      double value;
+      src = GetVarint(src, &peer_id);
+      src = GetVarint(src, &degree);
+      memcpy(&value, src, sizeof(value));
+      src += sizeof(value);
+      src = GetVarint(src, &dist);
+      src = GetVarint(src, &next_hop);
+      out->peers.Append(peer_id, degree, value, next_hop, dist);
       num_peers--;
     }
+    *len = src - buf;
     return out;
   }
 
+  // size of a marshalled level, found by skipping over it
+  uint32_t LubyLevel::MarshalledSizeAt(const uint8_t *buf) {
+    const uint8_t *src = buf;
+    uint32_t v;
+    uint32_t num_peers;
+    src = GetVarint(src, &v);   // level
+    src = GetVarint(src, &v);   // rep
+    src = GetVarint(src, &v);   // rep_dist
+    src += sizeof(double);
+    src = GetVarint(src, &num_peers);
+    while(num_peers > 0) {
+      src = GetVarint(src, &v); // id
+      src = GetVarint(src, &v); // degree
+      src += sizeof(double);
+      src = GetVarint(src, &v); // dist
+      src = GetVarint(src, &v); // next_hop
+      num_peers--;
+    }
+    return src - buf;
+  }
+
   void LubyLevel::ResetPeers() {
     NS_LOG_FUNCTION(this);
     NS_LOG_DEBUG("resetting level " << level << " peers");
-    for(std::map<uint32_t, LubyPeer*>::iterator it = peers.begin();
-        it != peers.end(); it++) {
-      delete it->second;
-    }
     peers.clear();
   }
 
@@ -143,25 +182,199 @@ namespace ns3 {
 
   LubyMIS::LubyMIS(bool d3_output) {
     m_d3_output = d3_output;
+    m_myid = 0;
+    m_structure_digest = 0;
+    m_msgs_skipped = 0;
+    m_aggregate = AGGREGATE_MEDIAN;
+    m_trim = 0.0;
+    m_segment_priority = SEGMENT_BY_LEVEL;
+    m_segmented = 0;
     m_value = ((double)rand()) / RAND_MAX;
     LubyLevel* level0 = new LubyLevel();
     level0->level = 0;
     m_levels.push_back(level0);
+    m_state_digest = Digest(true);
   }
   
   LubyMIS::~LubyMIS() {}
 
-  uint32_t LubyMIS::GetMarshalledSize() {
+  const char* LubyMIS::GetProtocolName() {
+    return "LubyMIS";
+  }
+
+  void LubyMIS::SetPeerTimeout(Time timeout) {
     NS_LOG_FUNCTION(this);
-    uint32_t total = (2 * sizeof(uint32_t)); // sender, num_levels
-    for(std::vector<LubyLevel*>::iterator it = m_levels.begin();
+    m_peer_timeout = timeout;
+    m_last_heard.clear();
+    if (m_peer_timeout.IsStrictlyPositive()) {
+      // quarter-timeout ticks: a neighbor goes between 1 and 1.25
+      // timeouts after we last heard from it
+      m_liveness = TimerWheel(m_peer_timeout / 4, 8);
+    }
+  }
+
+  void LubyMIS::SetChangeCallback(ChangeCallback cb) {
+    NS_LOG_FUNCTION(this);
+    m_on_change = cb;
+    m_structure_digest = 0;
+  }
+
+  void LubyMIS::SetAggregate(Aggregate aggregate, double trim) {
+    NS_LOG_FUNCTION(this);
+    NS_ASSERT(trim >= 0 && trim < 0.5);
+    m_aggregate = aggregate;
+    m_trim = trim;
+    for(uint32_t n = 0; n < m_levels.size(); n++) {
+      m_levels.at(n)->value_stale = true;
+    }
+    StateChanged();
+  }
+
+  void LubyMIS::SetSegmentPriority(SegmentPriority priority) {
+    NS_LOG_FUNCTION(this);
+    m_segment_priority = priority;
+  }
+
+  uint32_t LubyMIS::GetId() const {
+    return m_myid;
+  }
+
+  Ipv4Address LubyMIS::GetIpv4Address(uint32_t id) {
+    if (id >= g_ipv4_by_id.size()) return Ipv4Address((uint32_t)0);
+    return Ipv4Address(g_ipv4_by_id[id]);
+  }
+
+  const std::vector<LubyLevel*>& LubyMIS::GetLevels() const {
+    return m_levels;
+  }
+
+  // FNV-1a over my state; without values it covers only the structure
+  // of the hierarchy, since values change all the time
+  uint64_t LubyMIS::Digest(bool with_values) const {
+    uint64_t h = 14695981039346656037ULL;
+    uint64_t words[6];
+    uint32_t level_words = with_values ? 6 : 4;
+    uint32_t peer_words = with_values ? 5 : 4;
+    for(uint32_t n = 0; n < m_levels.size(); n++) {
+      LubyLevel* lvl = m_levels.at(n);
+      words[0] = lvl->rep;
+      words[1] = lvl->rep_next_hop;
+      words[2] = lvl->rep_dist;
+      words[3] = lvl->peers.size();
+      memcpy(&words[4], &lvl->rep_value, sizeof(double));
+      words[5] = lvl->value_stale;
+      for(uint32_t w = 0; w < level_words; w++) {
+        h = (h ^ words[w]) * 1099511628211ULL;
+      }
+      const LubyPeerTable &peers = lvl->peers;
+      for(uint32_t i = 0; i < peers.size(); i++) {
+        words[0] = peers.id[i];
+        words[1] = peers.next_hop[i];
+        words[2] = peers.dist[i];
+        words[3] = peers.degree[i];
+        memcpy(&words[4], &peers.value[i], sizeof(double));
+        for(uint32_t w = 0; w < peer_words; w++) {
+          h = (h ^ words[w]) * 1099511628211ULL;
+        }
+      }
+    }
+    return h;
+  }
+
+  // FNV-1a over the raw bytes of a marshalled message
+  uint64_t LubyMIS::MessageDigest(const uint8_t *buf) {
+    uint32_t sender;
+    uint32_t num_levels;
+    uint32_t len = GetVarint(GetVarint(buf, &sender), &num_levels) - buf;
+    while(num_levels > 0) {
+      len += LubyLevel::MarshalledSizeAt(buf + len);
+      num_levels--;
+    }
+    uint64_t h = 14695981039346656037ULL;
+    for(uint32_t i = 0; i < len; i++) {
+      h = (h ^ buf[i]) * 1099511628211ULL;
+    }
+    return h;
+  }
+
+  void LubyMIS::StateChanged() {
+    m_state_digest = Digest(true);
+    NotifyIfChanged();
+  }
+
+  void LubyMIS::NotifyIfChanged() {
+    // nothing to report until the node knows who it is; the factory
+    // configures new instances before their ids are set
+    if (m_on_change.IsNull() || m_myid == 0) return;
+    uint64_t digest = Digest(false);
+    if (digest != m_structure_digest) {
+      m_structure_digest = digest;
+      m_on_change(this);
+    }
+  }
+
+  void LubyMIS::HeardFrom(uint32_t sender) {
+    NS_LOG_FUNCTION(this);
+    if (!m_peer_timeout.IsStrictlyPositive()) return;
+    Time now = Simulator::Now();
+    std::map<uint32_t, Time>::iterator it = m_last_heard.find(sender);
+    if (it == m_last_heard.end()) {
+      m_last_heard[sender] = now;
+      m_liveness.Schedule(sender, now + m_peer_timeout);
+    } else {
+      // the wheel entry is re-armed lazily when it comes due
+      it->second = now;
+    }
+  }
+
+  void LubyMIS::ExpireSilentNeighbors() {
+    NS_LOG_FUNCTION(this);
+    if (!m_peer_timeout.IsStrictlyPositive()) return;
+    Time now = Simulator::Now();
+    std::vector<uint32_t> due;
+    m_liveness.Advance(now, due);
+    for(std::vector<uint32_t>::iterator it = due.begin();
+        it != due.end(); it++) {
+      std::map<uint32_t, Time>::iterator heard = m_last_heard.find(*it);
+      if (heard == m_last_heard.end()) continue;
+      Time deadline = heard->second + m_peer_timeout;
+      if (deadline > now) {
+        m_liveness.Schedule(*it, deadline);
+        continue;
+      }
+      Ipv4Address a = GetIpv4Address(*it);
+      if (m_d3_output) {
+        NS_LOG_INFO("D3 events.push({type:\"expire\",node:\"" << m_myip <<
+                    "\",peer:\"" << a << "\",time:" << now.GetSeconds() <<
+                    "});");
+      } else {
+        NS_LOG_INFO("neighbor " << a << " silent since " <<
+                    heard->second.GetSeconds() << "s; expiring it");
+      }
+      m_last_heard.erase(heard);
+      DropNeighbor(*it);
+    }
+  }
+
+  // called before every send, so it's where quiet nodes notice that
+  // their neighbors went silent
+  void LubyMIS::PrepareToSend() {
+    NS_LOG_FUNCTION(this);
+    ExpireSilentNeighbors();
+  }
+
+  uint32_t LubyMIS::GetMarshalledSize() const {
+    NS_LOG_FUNCTION(this);
+    uint32_t total = VarintSize(m_myid) + VarintSize(m_levels.size());
+    for(std::vector<LubyLevel*>::const_iterator it = m_levels.begin();
         it != m_levels.end(); it++) {
       total += (*it)->GetMarshalledSize();
     }
     return total;
   }
 
-  void LubyMIS::AppendIpv4AddressAsString(char *buf, uint32_t a) {
+  void LubyMIS::AppendIpv4AddressAsString(char *buf, uint32_t id) {
+    uint32_t a = GetIpv4Address(id).Get();
     sprintf(buf + strlen(buf), "%d.", a >> 24);
     sprintf(buf + strlen(buf), "%d.", (a >> 16) & 0xff);
     sprintf(buf + strlen(buf), "%d.", (a >> 8) & 0xff);
@@ -170,23 +383,123 @@ namespace ns3 {
 
   void LubyMIS::MarshalTo(uint8_t const *buf) {
     NS_LOG_FUNCTION(this);
+    // no ExpireSilentNeighbors() here: the buffer was sized for the
+    // current state
     uint8_t *dst = (uint8_t *)buf;
-    memcpy(dst, &(m_levels.at(0)->rep), sizeof(uint32_t));
-    dst += sizeof(uint32_t);
-    uint32_t num_levels = m_levels.size();
-    memcpy(dst, &num_levels, sizeof(num_levels));
-    dst += sizeof(num_levels);
+    dst = PutVarint(dst, m_levels.at(0)->rep);
+    dst = PutVarint(dst, m_levels.size());
     for(std::vector<LubyLevel*>::iterator it = m_levels.begin();
         it != m_levels.end(); it++) {
       dst = (*it)->MarshalTo(dst);
     }
   }
 
+  // Segments are cut between records -- a level's header, or one of its
+  // peers -- and hold as many whole records as fit, in message order.
+  // Each segment then ranks as the most urgent level it carries.
+  void LubyMIS::Segment(uint8_t const *buf, uint32_t size,
+                        uint32_t max_bytes,
+                        std::vector<DmcSegment> &segments) {
+    NS_LOG_FUNCTION(this << size << max_bytes);
+    NS_ASSERT(max_bytes > 0);
+    uint32_t sender;
+    uint32_t num_levels;
+    const uint8_t *src = GetVarint(GetVarint(buf, &sender), &num_levels);
+    if (m_level_digests.size() < num_levels) {
+      m_level_digests.resize(num_levels, 0);
+      m_level_changed.resize(num_levels, 0);
+    }
+    m_segmented++;
+
+    // (end of record, level); the message header rides with the first
+    m_records.clear();
+    for(uint32_t n = 0; n < num_levels; n++) {
+      const uint8_t *level_start = src;
+      uint32_t v;
+      uint32_t num_peers;
+      src = GetVarint(src, &v);   // level
+      src = GetVarint(src, &v);   // rep
+      src = GetVarint(src, &v);   // rep_dist
+      src += sizeof(double);
+      src = GetVarint(src, &num_peers);
+      m_records.push_back(std::make_pair((uint32_t)(src - buf), n));
+      while(num_peers > 0) {
+        src = GetVarint(src, &v); // id
+        src = GetVarint(src, &v); // degree
+        src += sizeof(double);
+        src = GetVarint(src, &v); // dist
+        src = GetVarint(src, &v); // next_hop
+        m_records.push_back(std::make_pair((uint32_t)(src - buf), n));
+        num_peers--;
+      }
+      uint64_t h = 14695981039346656037ULL;
+      for(const uint8_t *p = level_start; p < src; p++) {
+        h = (h ^ *p) * 1099511628211ULL;
+      }
+      if (h != m_level_digests[n]) {
+        m_level_digests[n] = h;
+        m_level_changed[n] = m_segmented;
+      }
+    }
+    NS_ASSERT((uint32_t)(src - buf) == size);
+
+    // (rank, position) of each segment, so that equal ranks keep
+    // message order
+    std::vector<std::pair<uint64_t, uint32_t> > order;
+    std::vector<DmcSegment> cut;
+    const uint64_t none = ~(uint64_t)0;
+    uint64_t rank = none;
+    uint32_t start = 0;
+    uint32_t taken = 0;
+    for(uint32_t i = 0; i < m_records.size(); i++) {
+      uint32_t end = m_records[i].first;
+      if (end - start > max_bytes && taken > start) {
+        DmcSegment seg = { start, taken - start };
+        order.push_back(std::make_pair(rank, cut.size()));
+        cut.push_back(seg);
+        start = taken;
+        rank = none;
+      }
+      uint64_t level_rank = SegmentRank(m_records[i].second);
+      // only a tiny max_bytes splits a record
+      while(end - start > max_bytes) {
+        DmcSegment seg = { start, max_bytes };
+        order.push_back(std::make_pair(std::min(rank, level_rank),
+                                       cut.size()));
+        cut.push_back(seg);
+        start += max_bytes;
+        rank = none;
+      }
+      rank = std::min(rank, level_rank);
+      taken = end;
+    }
+    if (taken > start) {
+      DmcSegment seg = { start, taken - start };
+      order.push_back(std::make_pair(rank, cut.size()));
+      cut.push_back(seg);
+    }
+
+    std::sort(order.begin(), order.end());
+    segments.clear();
+    for(uint32_t i = 0; i < order.size(); i++) {
+      segments.push_back(cut[order[i].second]);
+    }
+  }
+
+  // Lower ranks go first.  By level, lower levels lead, since everything
+  // above is built on them; by recency, the levels that changed most
+  // recently lead, lowest level first among equals.
+  uint64_t LubyMIS::SegmentRank(uint32_t n) const {
+    if (m_segment_priority == SEGMENT_BY_LEVEL) return n;
+    uint64_t age = m_segmented - m_level_changed.at(n);
+    return (age << 32) | n;
+  }
+
   void LubyMIS::DumpState(const char *label) {
     NS_LOG_FUNCTION(this);
     char dbuf[4096];
-    sprintf(dbuf, "%s { m_myaddr: ", label);
-    AppendIpv4AddressAsString(dbuf, m_myaddr);
+    sprintf(dbuf, "%s { m_myid: ", label);
+    AppendIpv4AddressAsString(dbuf, m_myid);
     sprintf(dbuf + strlen(dbuf), ", levels: [");
     for(std::vector<LubyLevel*>::iterator it = m_levels.begin();
         it != m_levels.end(); it++) {
@@ -197,14 +510,14 @@ namespace ns3 {
       sprintf(dbuf + strlen(dbuf), "rep: ");
       AppendIpv4AddressAsString(dbuf, (*it)->rep);
       sprintf(dbuf + strlen(dbuf), ", peers: [");
-      for(std::map<uint32_t, LubyPeer*>::iterator it2 = (*it)->peers.begin();
-          it2 != (*it)->peers.end(); it2++) {
-        if (it2 != (*it)->peers.begin()) {
+      const LubyPeerTable &peers = (*it)->peers;
+      for(uint32_t i = 0; i < peers.size(); i++) {
+        if (i > 0) {
           sprintf(dbuf + strlen(dbuf), ", ");
         }
         sprintf(dbuf + strlen(dbuf), "{ peer: ");
-        AppendIpv4AddressAsString(dbuf, it2->first);
-        sprintf(dbuf + strlen(dbuf), ", degree: %d }", it2->second->degree);
+        AppendIpv4AddressAsString(dbuf, peers.id[i]);
+        sprintf(dbuf + strlen(dbuf), ", degree: %d }", peers.degree[i]);
       }
       sprintf(dbuf + strlen(dbuf), "]}");
     }
@@ -227,14 +540,14 @@ namespace ns3 {
       sprintf(dbuf + strlen(dbuf), "rep: ");
       AppendIpv4AddressAsString(dbuf, (*it)->rep);
       sprintf(dbuf + strlen(dbuf), ", peers: [");
-      for(std::map<uint32_t, LubyPeer*>::iterator it2 = (*it)->peers.begin();
-          it2 != (*it)->peers.end(); it2++) {
-        if (it2 != (*it)->peers.begin()) {
+      const LubyPeerTable &peers = (*it)->peers;
+      for(uint32_t i = 0; i < peers.size(); i++) {
+        if (i > 0) {
           sprintf(dbuf + strlen(dbuf), ", ");
         }
         sprintf(dbuf + strlen(dbuf), "{ peer: ");
-        AppendIpv4AddressAsString(dbuf, it2->first);
-        sprintf(dbuf + strlen(dbuf), ", degree: %d }", it2->second->degree);
+        AppendIpv4AddressAsString(dbuf, peers.id[i]);
+        sprintf(dbuf + strlen(dbuf), ", degree: %d }", peers.degree[i]);
       }
       sprintf(dbuf + strlen(dbuf), "]}");
     }
@@ -247,24 +560,46 @@ namespace ns3 {
 
     //DumpState("PRE");
 
-    uint8_t *src = (uint8_t *)buf;
+    const uint8_t *src = buf;
     uint32_t sender;
-    memcpy(&sender, src, sizeof(sender));
-    src += sizeof(sender);
     uint32_t num_levels;
-    memcpy(&num_levels, src, sizeof(num_levels));
-    src += sizeof(num_levels);
+    src = GetVarint(src, &sender);
+    src = GetVarint(src, &num_levels);
+
+    ExpireSilentNeighbors();
+    HeardFrom(sender);
+
+    // In steady state a sender repeats itself.  If its last message
+    // changed nothing and my state hasn't changed since, this one won't
+    // either; only the rep lottery is left to run.
+    uint64_t digest = MessageDigest(buf);
+    std::map<uint32_t, SenderDigest>::iterator last =
+      m_sender_digests.find(sender);
+    if (last != m_sender_digests.end() &&
+        last->second.message == digest &&
+        last->second.state_before == last->second.state_after &&
+        last->second.state_after == m_state_digest) {
+      m_msgs_skipped++;
+      uint32_t top_rep = m_levels.back()->rep;
+      TryToBecomeRep();
+      if (m_levels.back()->rep != top_rep) StateChanged();
+      return;
+    }
+    SenderDigest &record = m_sender_digests[sender];
+    record.message = digest;
+    record.state_before = m_state_digest;
 
     std::vector<LubyLevel*> msg_levels;
     while(num_levels > 0) {
-      LubyLevel* lvl = LubyLevel::MarshalFrom(src);
-      src += lvl->GetMarshalledSize();
+      uint32_t len;
+      LubyLevel* lvl = LubyLevel::MarshalFrom(src, &len);
+      src += len;
       msg_levels.push_back(lvl);
       num_levels--;
     }
 
     //DumpMessage(sender, msg_levels);
-    
+
     for(uint32_t n = 0; n < msg_levels.size() && n < m_levels.size(); n++) {
       ProcessTopologyChanges(sender, msg_levels, n);
       TryToStartNewLevel();
@@ -285,32 +620,31 @@ namespace ns3 {
         it != msg_levels.end(); it++) {
       delete (*it);
     }
+    StateChanged();
+    record.state_after = m_state_digest;
   }
 
   void LubyMIS::ProcessTopologyChanges(uint32_t sender,
                                        std::vector<LubyLevel*> msg_levels,
                                        uint32_t n) {
-    Ipv4Address a(sender);
+    Ipv4Address a = GetIpv4Address(sender);
     Ipv4Address a2;
 
     NS_LOG_FUNCTION(this << n);
     if (n == 0) {
-      LubyLevel* lev0 = m_levels.at(0);
-      if (lev0->peers.count(sender) == 0) {
+      LubyPeerTable &peers0 = m_levels.at(0)->peers;
+      uint32_t degree = msg_levels.at(0)->peers.size();
+      uint32_t i = peers0.Find(sender);
+      if (i == peers0.size()) {
         NS_LOG_DEBUG("found new level 0 peer " << a);
-        LubyPeer* peer = new LubyPeer();
-        peer->degree = msg_levels.at(0)->peers.size();
-        peer->next_hop = sender;
-        peer->dist = 1;
-        lev0->peers[sender] = peer;
+        peers0.Insert(sender, degree, 0.0, sender, 1);
         SetMaxLevel(0);
-      } else if (lev0->peers[sender]->degree !=
-                 msg_levels.at(0)->peers.size()) {
-        a2.Set(sender);
+      } else if (peers0.degree[i] != degree) {
+        a2 = GetIpv4Address(sender);
         NS_LOG_DEBUG("detected change in degree for level " << n <<
-                     " peer " << a2 << ": " << lev0->peers[sender]->degree <<
-                     "->" << msg_levels.at(n)->peers.size());
-        lev0->peers[sender]->degree = msg_levels.at(0)->peers.size();
+                     " peer " << a2 << ": " << peers0.degree[i] <<
+                     "->" << degree);
+        peers0.degree[i] = degree;
         SetMaxLevel(0);
       }
       return;
@@ -325,192 +659,210 @@ namespace ns3 {
     
     if (msg_levels.at(n)->rep == 0) {
       // remove any peers where the sender is the next hop
-      std::vector<uint32_t> peers_to_remove;
-      std::map<uint32_t, LubyPeer*>::iterator it;
-      for(it = m_levels.at(n)->peers.begin();
-          it != m_levels.at(n)->peers.end(); it++) {
-        if (it->second->next_hop == sender) {
-          peers_to_remove.push_back(it->first);
-        }
-      }
-      for(std::vector<uint32_t>::iterator peer = peers_to_remove.begin();
-          peer != peers_to_remove.end(); peer++) {
-        a2.Set(*peer);
-        delete m_levels.at(n)->peers[*peer];
-        m_levels.at(n)->peers[*peer] = NULL;
-        m_levels.at(n)->peers.erase(m_levels.at(n)->peers.find(*peer));
-        SetMaxLevel(n);
+      LubyPeerTable &peers = m_levels.at(n)->peers;
+      peers.SelectNextHop(sender, &m_selected);
+      for(uint32_t i = 0; i < m_selected.size(); i++) {
+        a2 = GetIpv4Address(peers.id[m_selected[i]]);
         NS_LOG_DEBUG("removing level-" << n << " peer " << a2 << 
                      " b/c it was learned via sender " << a << " who no" <<
                      " longer has a level-" << n << " rep");
-                     
+      }
+      if (!m_selected.empty()) {
+        peers.Erase(m_selected);
+        SetMaxLevel(n);
       }
       return;
     }
 
     if (m_levels.at(n)->rep == msg_levels.at(n)->rep) {
       // this is from a member of my level-n group; level n peers should be
-      // merged.
-
-      // first, remove any level n peers whose next hop is the sender but
-      // where the sender is no longer advertising that peer; also look for
-      // peers whose degree has changed.
-      std::vector<uint32_t> peers_to_remove;
-      std::map<uint32_t, LubyPeer*>::iterator it;
-      for(it = m_levels.at(n)->peers.begin();
-          it != m_levels.at(n)->peers.end(); it++) {
-        if (it->first == sender) {
-          // sender is in my level-n group; it can't be a peer!
-          NS_LOG_DEBUG("sender " << a << " is in my level " << n <<
-                       " group but is listed as a level " << n << " peer");
-          peers_to_remove.push_back(it->first);
-        } else if (it->second->next_hop == sender) {
-          a2.Set(it->first);
-          if (msg_levels.at(n)->peers.count(it->first) == 0) {
+      // merged.  Both peer lists are sorted by id, so a single merge pass
+      // sees each id as mine only, the sender's only, or in both; the
+      // merged list is built up in m_merged and swapped in at the end.
+      LubyPeerTable &mine = m_levels.at(n)->peers;
+      const LubyPeerTable &theirs = msg_levels.at(n)->peers;
+      LubyPeerTable &merged = m_merged;
+      uint32_t max_dist = m_levels.at(n)->MaxPeerDistance();
+      bool changed = false;
+      merged.clear();
+      merged.reserve(mine.size() + theirs.size());
+      uint32_t i = 0;
+      uint32_t j = 0;
+      while(i < mine.size() || j < theirs.size()) {
+        if (j == theirs.size() ||
+            (i < mine.size() && mine.id[i] < theirs.id[j])) {
+          // mine only: drop it if the sender was my route to it
+          a2 = GetIpv4Address(mine.id[i]);
+          if (mine.id[i] == sender) {
+            // sender is in my level-n group; it can't be a peer!
+            NS_LOG_DEBUG("sender " << a << " is in my level " << n <<
+                         " group but is listed as a level " << n << " peer");
+          } else if (mine.next_hop[i] == sender) {
             NS_LOG_DEBUG("sender " << a << " no longer advertising level "
                          << n << " peer " << a2);
-            peers_to_remove.push_back(it->first);
-          } else if (it->second->next_hop == m_myaddr) {
+          } else {
+            merged.Append(mine.id[i], mine.degree[i], mine.value[i],
+                          mine.next_hop[i], mine.dist[i]);
+            i++;
+            continue;
+          }
+          NS_LOG_DEBUG("removing level " << n << " peer " << a2 << " (#1)");
+          changed = true;
+          i++;
+          continue;
+        }
+
+        if (i == mine.size() || theirs.id[j] < mine.id[i]) {
+          // the sender's only: a new peer with the sender as the next hop
+          if (theirs.id[j] != m_myid && // I can't be my own peer!
+              theirs.next_hop[j] != m_myid && // split horizon
+              theirs.dist[j] + 1 <= max_dist) {
+            merged.Append(theirs.id[j], theirs.degree[j], 0.0, sender,
+                          theirs.dist[j] + 1);
+            changed = true;
+            a2 = GetIpv4Address(theirs.id[j]);
+            NS_LOG_DEBUG("adding new level " << n << " peer " << a2 <<
+                         " at distance " << theirs.dist[j] + 1);
+          }
+          j++;
+          continue;
+        }
+
+        // in both: first check the route I have through the sender, and
+        // look for a change in degree
+        uint32_t id = mine.id[i];
+        uint32_t degree = mine.degree[i];
+        uint32_t next_hop = mine.next_hop[i];
+        uint32_t dist = mine.dist[i];
+        a2 = GetIpv4Address(id);
+        bool drop = false;
+        if (id == sender) {
+          NS_LOG_DEBUG("sender " << a << " is in my level " << n <<
+                       " group but is listed as a level " << n << " peer");
+          drop = true;
+        } else if (next_hop == sender) {
+          if (next_hop == m_myid) {
             NS_LOG_DEBUG("sender " << a << " learned route to peer " << a2
                          << " from me; dropping (split horizon)");
-            peers_to_remove.push_back(it->first);
-          } else if (it->second->dist == 1) {
+            drop = true;
+          } else if (dist == 1) {
             // if distance was 1 then the sender wasn't in my level-n
             // group when I learned of this peer
             NS_LOG_DEBUG("sender " << a << " used to be part of level "
                          << n << " peer " << a2 << " but isn't anymore");
-            peers_to_remove.push_back(it->first);
-          } else if (
-
-
-              // watch for routing loops
-              (msg_levels.at(n)->peers[it->first]->dist + 1 >
-               m_levels.at(n)->MaxPeerDistance())) {
+            drop = true;
+          } else if (theirs.dist[j] + 1 > max_dist) {
+            // watch for routing loops
             NS_LOG_DEBUG("routing loop to level-" << n << " peer " << a2
                          << " detected");
-            peers_to_remove.push_back(it->first);
-          } else if (msg_levels.at(n)->peers[it->first]->degree != it->second->degree) {
-            a2.Set(it->first);
+            drop = true;
+          } else if (theirs.degree[j] != degree) {
             NS_LOG_DEBUG("detected change in degree for level " << n <<
-                         " peer " << a2 << ": " << it->second->degree <<
-                         "->" << msg_levels.at(n)->peers[it->first]->degree);
-            it->second->degree = msg_levels.at(n)->peers[it->first]->degree;
-            SetMaxLevel(n);
+                         " peer " << a2 << ": " << degree <<
+                         "->" << theirs.degree[j]);
+            degree = theirs.degree[j];
+            changed = true;
           }
           // adjust route distance
-          m_levels.at(n)->peers[it->first]->dist = it->second->dist + 1;
+          dist++;
         }
-      }
-      for(std::vector<uint32_t>::iterator peer = peers_to_remove.begin();
-          peer != peers_to_remove.end(); peer++) {
-        a2.Set(*peer);
-        delete m_levels.at(n)->peers[*peer];
-        m_levels.at(n)->peers[*peer] = NULL;
-        m_levels.at(n)->peers.erase(m_levels.at(n)->peers.find(*peer));
-        SetMaxLevel(n);
-        NS_LOG_DEBUG("removing level " << n << " peer " << a2 << " (#1)");
-      }
 
-      // see if the sender has a lower-distance route to a peer than my
-      // current next hop
-      for(it = m_levels.at(n)->peers.begin();
-          it != m_levels.at(n)->peers.end(); it++) {
-        if (msg_levels.at(n)->peers.count(it->first) > 0) {
-          LubyPeer* sender_peer = msg_levels.at(n)->peers[it->first];
-          if (sender_peer->dist + 1 < it->second->dist) {
+        if (drop) {
+          NS_LOG_DEBUG("removing level " << n << " peer " << a2 << " (#1)");
+          changed = true;
+          if (id != m_myid &&
+              theirs.next_hop[j] != m_myid &&
+              theirs.dist[j] + 1 <= max_dist) {
+            // relearn it from what the sender advertises
+            merged.Append(id, theirs.degree[j], 0.0, sender,
+                          theirs.dist[j] + 1);
+            NS_LOG_DEBUG("adding new level " << n << " peer " << a2 <<
+                         " at distance " << theirs.dist[j] + 1);
+          }
+        } else {
+          // see if the sender has a lower-distance route to the peer than
+          // my current next hop
+          if (theirs.dist[j] + 1 < dist) {
             // better route
-            it->second->next_hop = sender;
-            it->second->dist = sender_peer->dist + 1;
-            if (sender_peer->degree != it->second->degree) {
-              a2.Set(it->first);
+            next_hop = sender;
+            dist = theirs.dist[j] + 1;
+            if (theirs.degree[j] != degree) {
               NS_LOG_DEBUG("detected change in degree for level " << n <<
-                           " peer " << a2 << ": " << it->second->degree <<
-                           "->" << sender_peer->degree);
-              it->second->degree = sender_peer->degree;
-              SetMaxLevel(n);
+                           " peer " << a2 << ": " << degree <<
+                           "->" << theirs.degree[j]);
+              degree = theirs.degree[j];
+              changed = true;
             }
           }
+          merged.Append(id, degree, mine.value[i], next_hop, dist);
         }
+        i++;
+        j++;
       }
-      
-      // next, add any new level-n peers with the sender as the next hop
-      for(it = msg_levels.at(n)->peers.begin();
-          it != msg_levels.at(n)->peers.end(); it++) {
-        if (it->first != m_myaddr && // I can't be my own peer!
-            m_levels.at(n)->peers.count(it->first) == 0 &&
-            it->second->next_hop != m_myaddr && // split horizon
-            it->second->dist + 1 <= msg_levels.at(n)->MaxPeerDistance()) {
-          LubyPeer* p = new LubyPeer();
-          p->degree = it->second->degree;
-          p->next_hop = sender;
-          p->dist = it->second->dist + 1;
-          m_levels.at(n)->peers[it->first] = p;
-          SetMaxLevel(n);
-          a2.Set(it->first);
-          NS_LOG_DEBUG("adding new level " << n << " peer " << a2 << 
-                       " at distance " << p->dist);
-        }
-      }
+      mine.swap(merged);
+      if (changed) SetMaxLevel(n);
     } else {
       // this is from a member of a level-n peer group; 
       
       // remove any level-n
       // peers where the sender is the next hop but the sender's rep is
       // different; also check if the peer's degree changed
-      std::vector<uint32_t> peers_to_remove;
-      std::map<uint32_t, LubyPeer*>::iterator it;
-      for(it = m_levels.at(n)->peers.begin();
-          it != m_levels.at(n)->peers.end(); it++) {
-        if (it->first == msg_levels.at(n)->rep &&
-            it->second->dist > 1) {
-          peers_to_remove.push_back(it->first);
-        } else if (it->second->next_hop == sender) {
-          if (it->first != msg_levels.at(n)->rep) {
-            peers_to_remove.push_back(it->first);
-          } else if (it->second->degree != msg_levels.at(n)->peers.size()) {
-            a2.Set(it->first);
-            NS_LOG_DEBUG("detected degree change for level " << n <<
-                         " peer " << a2 << ": " << it->second->degree <<
-                         "->" << msg_levels.at(n)->peers.size());
-            if (msg_levels.at(n)->peers.size() > 0) {
-              it->second->degree = msg_levels.at(n)->peers.size();
-              SetMaxLevel(n);
-            } else {
-              peers_to_remove.push_back(it->first);
-            }
+      LubyPeerTable &peers = m_levels.at(n)->peers;
+      uint32_t rep = msg_levels.at(n)->rep;
+      uint32_t rep_degree = msg_levels.at(n)->peers.size();
+      uint32_t r = peers.Find(rep);
+      bool drop_rep = false;
+      if (r != peers.size()) {
+        if (peers.dist[r] > 1) {
+          drop_rep = true;
+        } else if (peers.next_hop[r] == sender &&
+                   peers.degree[r] != rep_degree) {
+          a2 = GetIpv4Address(rep);
+          NS_LOG_DEBUG("detected degree change for level " << n <<
+                       " peer " << a2 << ": " << peers.degree[r] <<
+                       "->" << rep_degree);
+          if (rep_degree > 0) {
+            peers.degree[r] = rep_degree;
+            SetMaxLevel(n);
+          } else {
+            drop_rep = true;
           }
         }
       }
-      for(std::vector<uint32_t>::iterator peer = peers_to_remove.begin();
-          peer != peers_to_remove.end(); peer++) {
-        a2.Set(*peer);
+      // of the peers reached through the sender only its rep may stay
+      peers.SelectNextHop(sender, &m_selected);
+      std::vector<uint32_t>::iterator pos =
+        std::lower_bound(m_selected.begin(), m_selected.end(), r);
+      bool selected_rep = (pos != m_selected.end() && *pos == r);
+      if (selected_rep && !drop_rep) {
+        m_selected.erase(pos);
+      } else if (!selected_rep && drop_rep) {
+        m_selected.insert(pos, r);
+      }
+      for(uint32_t i = 0; i < m_selected.size(); i++) {
+        a2 = GetIpv4Address(peers.id[m_selected[i]]);
         NS_LOG_DEBUG("removing level " << n << " peer " << a2 << " (#2)");
-        delete m_levels.at(n)->peers[*peer];
-        m_levels.at(n)->peers[*peer] = NULL;
-        m_levels.at(n)->peers.erase(m_levels.at(n)->peers.find(*peer));
+      }
+      if (!m_selected.empty()) {
+        peers.Erase(m_selected);
         SetMaxLevel(n);
       }
 
       // then if the sender's rep is not present we should add
       // it as a peer.
-      if (msg_levels.at(n)->rep != 0 &&
-          m_levels.at(n)->peers.count(msg_levels.at(n)->rep) == 0) {
-        if (msg_levels.at(n)->rep != m_myaddr) {
-          LubyPeer* p = new LubyPeer();
-          p->degree = msg_levels.at(n)->peers.size();
-          p->next_hop = sender;
-          p->dist = 1;
-          m_levels.at(n)->peers[msg_levels.at(n)->rep] = p;
+      if (rep != 0 && !peers.Contains(rep)) {
+        if (rep != m_myid) {
+          peers.Insert(rep, rep_degree, 0.0, sender, 1);
           SetMaxLevel(n);
-          a2.Set(msg_levels.at(n)->rep);
+          a2 = GetIpv4Address(rep);
           NS_LOG_DEBUG("adding new level " << n << " peer " << a2);
         }
       }
       
       // sender's rep should be a peer of distance 1
-      if (msg_levels.at(n)->rep != 0 &&
-          m_levels.at(n)->peers.count(msg_levels.at(n)->rep) > 0) {
-        m_levels.at(n)->peers[msg_levels.at(n)->rep]->dist = 1;
+      r = peers.Find(rep);
+      if (rep != 0 && r != peers.size()) {
+        peers.dist[r] = 1;
       }
     }
 
@@ -520,7 +872,7 @@ namespace ns3 {
                    " peers; should not be running at a higher level");
       SetMaxLevel(n);
     }
-    if (m_levels.at(n)->rep == m_myaddr &&
+    if (m_levels.at(n)->rep == m_myid &&
         m_levels.at(n-1)->peers.size() == 0) {
       NS_LOG_DEBUG("I'm a level " << n << " rep but have no level " <<
                    (n-1) << " peers; dropping level");
@@ -568,12 +920,12 @@ namespace ns3 {
     // my level n-1 rep or one of my level n-1 peers
     if ((m_levels.at(n)->rep != 0 &&
          m_levels.at(n)->rep != m_levels.at(n-1)->rep &&
-         m_levels.at(n-1)->peers.count(m_levels.at(n)->rep) == 0)
+         !m_levels.at(n-1)->peers.Contains(m_levels.at(n)->rep))
         ||
         (m_levels.at(n)->rep_next_hop == sender &&
          m_levels.at(n)->rep != msg_levels.at(n)->rep)
         ) {
-      a.Set(m_levels.at(n)->rep);
+      a = GetIpv4Address(m_levels.at(n)->rep);
       m_levels.at(n)->rep = m_levels.at(n)->rep_next_hop = m_levels.at(n)->rep_dist = 0;
       SetMaxLevel(n);
       m_levels.at(n)->ResetPeers();
@@ -593,7 +945,7 @@ namespace ns3 {
         m_levels.at(n)->rep = m_levels.at(n)->rep_next_hop = m_levels.at(n)->rep_dist = 0;
         SetMaxLevel(n);
         m_levels.at(n)->ResetPeers();
-        a.Set(sender);
+        a = GetIpv4Address(sender);
         if (m_d3_output) {
           NS_LOG_INFO("D3 events.push({type:\"unelect\",node:\"" <<
                       m_myip << "\",level:" << n << ",time:" <<
@@ -611,7 +963,7 @@ namespace ns3 {
         m_levels.at(n)->rep = m_levels.at(n)->rep_next_hop = m_levels.at(n)->rep_dist = 0;
         SetMaxLevel(n);
         m_levels.at(n)->ResetPeers();
-        a.Set(sender);
+        a = GetIpv4Address(sender);
         if (m_d3_output) {
           NS_LOG_INFO("D3 events.push({type:\"unelect\",node:\"" <<
                       m_myip << "\",level:" << n << ",time:" <<
@@ -625,83 +977,29 @@ namespace ns3 {
         // nothing to do here; ignore it
       }
     } else {
-      // sender has a level-n rep that is a possibility for me because
-      // it is either my level n-1 rep or is one of my n-1 peers
-      if ((msg_levels.at(n)->rep == m_levels.at(n-1)->rep ||
-           m_levels.at(n-1)->peers.count(msg_levels.at(n)->rep) > 0) &&
-
-          // this would be a rep change
-          msg_levels.at(n)->rep != m_levels.at(n)->rep &&
-
-          // this is a valid route
-          // msg_levels.at(n)->rep_dist + 1 < msg_levels.at(n)->MaxPeerDistance() &&
-
-          (// I'm only sixteen, I don't have a rep yet.
-           (m_levels.at(n)->rep == 0)
-           ||
-
-           // My current level n rep is one of my level n-1 peers, and
-           // the sender is part of my level n-1 group and that rep has
-           // a higher degree than my current one
-           (m_levels.at(n-1)->peers.count(m_levels.at(n)->rep) > 0 &&
-            msg_levels.at(n)->rep == m_levels.at(n-1)->rep &&
-            (m_levels.at(n-1)->peers.size() >
-             m_levels.at(n-1)->peers[m_levels.at(n)->rep]->degree))
-           ||
-
-           // My current level n rep is one of my level n-1 peers, and
-           // the sender is part of my level n-1 group and that rep has
-           // the same degree but lower address than my current one
-           (m_levels.at(n-1)->peers.count(m_levels.at(n)->rep) > 0 &&
-            msg_levels.at(n)->rep == m_levels.at(n-1)->rep &&
-            (m_levels.at(n-1)->peers.size() ==
-             m_levels.at(n-1)->peers[m_levels.at(n)->rep]->degree) &&
-            msg_levels.at(n)->rep < m_levels.at(n)->rep)
-           ||
-
-           // My current level n rep is also my level n-1 rep, but the
-           // sender is part of a level n-1 peer with higher degree
-           (m_levels.at(n)->rep == m_levels.at(n-1)->rep &&
-            m_levels.at(n-1)->rep != msg_levels.at(n-1)->rep &&
-            m_levels.at(n-1)->peers.count(msg_levels.at(n)->rep) != 0 &&
-            (m_levels.at(n-1)->peers[msg_levels.at(n)->rep]->degree >
-             m_levels.at(n-1)->peers.size()))
-           ||
-           // My current level n rep is also my level n-1 rep, but the
-           // sender is part of a level n-1 peer with the same degree but
-           // a lower address
-           (m_levels.at(n)->rep == m_levels.at(n-1)->rep &&
-            m_levels.at(n-1)->rep != msg_levels.at(n-1)->rep &&
-            m_levels.at(n-1)->peers.count(msg_levels.at(n)->rep) != 0 &&
-            (m_levels.at(n-1)->peers[msg_levels.at(n)->rep]->degree ==
-             m_levels.at(n-1)->peers.size()) &&
-            msg_levels.at(n)->rep < m_levels.at(n)->rep)
-           ||
-           // Sender is part of a level n-1 peer with a higher degree than
-           // the level n-1 peer that is currently my rep
-           (m_levels.at(n-1)->rep != msg_levels.at(n-1)->rep &&
-            m_levels.at(n)->rep != m_levels.at(n-1)->rep &&
-            m_levels.at(n-1)->peers.count(msg_levels.at(n)->rep) != 0 &&
-            (m_levels.at(n-1)->peers[msg_levels.at(n)->rep]->degree >
-             m_levels.at(n-1)->peers[m_levels.at(n)->rep]->degree))
-           ||
-           // Sender is part of a level n-1 peer with the same degree as
-           // the level n-1 peer that is currently my rep but has a lower
-           // address
-           (m_levels.at(n-1)->rep != msg_levels.at(n-1)->rep &&
-            m_levels.at(n)->rep != m_levels.at(n-1)->rep &&
-            m_levels.at(n-1)->peers.count(msg_levels.at(n)->rep) != 0 &&
-            (m_levels.at(n-1)->peers[msg_levels.at(n)->rep]->degree ==
-             m_levels.at(n-1)->peers[m_levels.at(n)->rep]->degree) &&
-            msg_levels.at(n)->rep < m_levels.at(n)->rep))
-          ) {
+      // sender has a level-n rep that is a possibility for me if it is
+      // either my level n-1 rep or one of my level n-1 peers; take it if
+      // I have no rep yet or it outranks my current one.  A rep from a
+      // peer group only counts when the sender is outside my level n-1
+      // group; my own group's rep may come from anyone.
+      LubyCandidate candidate;
+      LubyCandidate current;
+      uint32_t cand_id = msg_levels.at(n)->rep;
+      uint32_t cur_id = m_levels.at(n)->rep;
+      if (cand_id != cur_id &&
+          GetCandidate(n, cand_id, &candidate) &&
+          (cur_id == 0 ||
+           ((cand_id == m_levels.at(n-1)->rep ||
+             msg_levels.at(n-1)->rep != m_levels.at(n-1)->rep) &&
+            GetCandidate(n, cur_id, &current) &&
+            LubyElectionRanking::Better(candidate, current)))) {
         // take sender's
         m_levels.at(n)->rep = msg_levels.at(n)->rep;
         m_levels.at(n)->rep_next_hop = sender;
         m_levels.at(n)->rep_dist = msg_levels.at(n)->rep_dist + 1;
         SetMaxLevel(n);
         m_levels.at(n)->ResetPeers();
-        a.Set(m_levels.at(n)->rep);
+        a = GetIpv4Address(m_levels.at(n)->rep);
         if (m_d3_output) {
           NS_LOG_INFO("D3 events.push({type:\"elect\",node:\"" << m_myip <<
                       "\",level:" << n << ",rep:\"" << a <<
@@ -725,6 +1023,22 @@ namespace ns3 {
 
   }
 
+  // Look id up as a level-n rep candidate; false if it is neither my
+  // level n-1 rep nor one of my level n-1 peers
+  bool LubyMIS::GetCandidate(uint32_t n, uint32_t id,
+                             LubyCandidate *out) const {
+    LubyLevel* below = m_levels.at(n-1);
+    out->id = id;
+    if (id == below->rep) {
+      out->degree = below->peers.size();
+      return true;
+    }
+    uint32_t i = below->peers.Find(id);
+    if (i == below->peers.size()) return false;
+    out->degree = below->peers.degree[i];
+    return true;
+  }
+
   void LubyMIS::TrimVacatedLeadersAndPeers(uint32_t sender,
                                            std::vector<LubyLevel*> msg_levels) {
     NS_LOG_FUNCTION(this);
@@ -744,20 +1058,12 @@ namespace ns3 {
         }
         m_levels.at(n)->ResetPeers();
       } else {
-        std::map<uint32_t, LubyPeer*>::iterator it;
-        std::vector<uint32_t> peers_to_remove;
-        for(it = m_levels.at(n)->peers.begin();
-            it != m_levels.at(n)->peers.end(); it++) {
-          if (it->second->next_hop == sender) {
-            NS_LOG_INFO("level " << n << " peer next hop no longer at this level");
-            peers_to_remove.push_back(it->first);
-          }
+        m_levels.at(n)->peers.SelectNextHop(sender, &m_selected);
+        for(uint32_t i = 0; i < m_selected.size(); i++) {
+          NS_LOG_INFO("level " << n << " peer next hop no longer at this level");
         }
-        for(std::vector<uint32_t>::iterator peer = peers_to_remove.begin();
-            peer != peers_to_remove.end(); peer++) {
-          delete m_levels.at(n)->peers[*peer];
-          m_levels.at(n)->peers[*peer] = NULL;
-          m_levels.at(n)->peers.erase(m_levels.at(n)->peers.find(*peer));
+        if (!m_selected.empty()) {
+          m_levels.at(n)->peers.Erase(m_selected);
           SetMaxLevel(n);
         }
       }
@@ -769,16 +1075,17 @@ namespace ns3 {
     NS_LOG_FUNCTION(this);
     LubyLevel* max_level = m_levels.at(m_levels.size() - 1);
     if (max_level->rep == 0 &&
-        m_levels.at(max_level->level - 1)->rep == m_myaddr &&
+        m_levels.at(max_level->level - 1)->rep == m_myid &&
         m_levels.at(max_level->level - 1)->peers.size() > 0) {
       // I am a level N-1 rep, so might be able to become level N rep
       double roll = ((double)rand()) / RAND_MAX;
       if (roll < (1.0 / (2 * m_levels.at(max_level->level - 1)->peers.size()))) {
       // if (1) {
-        max_level->rep = m_myaddr;
-        max_level->rep_next_hop = m_myaddr;
+        max_level->rep = m_myid;
+        max_level->rep_next_hop = m_myid;
         max_level->rep_dist = 0;
-        a.Set(m_myaddr);
+        max_level->value_stale = true; // rep_value was my old rep's
+        a = m_myip;
         if (m_d3_output) {
           NS_LOG_INFO("D3 events.push({type:\"elect\",node:\"" <<
                       m_myip << "\",level:" << max_level->level <<
@@ -797,20 +1104,37 @@ namespace ns3 {
                                  std::vector<LubyLevel*> msg_levels) {
     NS_LOG_FUNCTION(this);
     for(uint32_t n = 0; n < m_levels.size() && n < msg_levels.size(); n++) {
+      bool changed = false;
+      double value;
       if (m_levels.at(n)->rep == msg_levels.at(n)->rep &&
           m_levels.at(n)->rep_next_hop == sender) {
-        m_levels.at(n)->rep_value = msg_levels.at(n)->rep_value;
-      }
-      std::map<uint32_t, LubyPeer*>::iterator it;
-      for(it = m_levels.at(n)->peers.begin();
-          it != m_levels.at(n)->peers.end(); it++) {
-        if (it->second->next_hop == sender) {
-          if (m_levels.at(n)->rep == msg_levels.at(n)->rep) {
-            it->second->value = msg_levels.at(n)->peers[it->first]->value;
-          } else {
-            it->second->value = msg_levels.at(n)->rep_value;
-          }
+        value = msg_levels.at(n)->rep_value;
+        changed = (m_levels.at(n)->rep_value != value);
+        m_levels.at(n)->rep_value = value;
+      }
+      LubyPeerTable &peers = m_levels.at(n)->peers;
+      const LubyPeerTable &theirs = msg_levels.at(n)->peers;
+      bool same_group = (m_levels.at(n)->rep == msg_levels.at(n)->rep);
+      peers.SelectNextHop(sender, &m_selected);
+      // both tables are in id order, so the sender's entries are found
+      // by walking its table once
+      uint32_t j = 0;
+      for(uint32_t s = 0; s < m_selected.size(); s++) {
+        uint32_t i = m_selected[s];
+        if (same_group) {
+          while(j < theirs.size() && theirs.id[j] < peers.id[i]) j++;
+          if (j == theirs.size() || theirs.id[j] != peers.id[i]) continue;
+          value = theirs.value[j];
+        } else {
+          value = msg_levels.at(n)->rep_value;
         }
+        changed = changed || (peers.value[i] != value);
+        peers.value[i] = value;
+      }
+      // peers coming and going truncate the levels above, so a value
+      // change is all the level above has to watch for
+      if (changed && n + 1 < m_levels.size()) {
+        m_levels.at(n + 1)->value_stale = true;
       }
     }
   }
@@ -818,73 +1142,244 @@ namespace ns3 {
   void LubyMIS::RecalculateLevelValues() {
     NS_LOG_FUNCTION(this);
     for(uint32_t n = 1; n < m_levels.size(); n++) {
-      if (m_levels.at(n)->rep == m_myaddr) {
-        // I'm the level-n rep, so I should calculate the median value
-        // for this level-n group: median of my level-n-1 group's value
-        // and the values of my level-n-1 peer groups
-        std::vector<double> values;
-        values.push_back(m_levels.at(n-1)->rep_value);
-        std::map<uint32_t, LubyPeer*>::iterator it;
-        for(it = m_levels.at(n-1)->peers.begin();
-            it != m_levels.at(n-1)->peers.end(); it++) {
-          values.push_back(it->second->value);
-        }
-        std::sort(values.begin(), values.end());
-        if (values.size() % 2 == 1) {
-          m_levels.at(n)->rep_value = values.at(values.size() / 2);
-        } else {
-          m_levels.at(n)->rep_value = 
-            (values.at(values.size() / 2 - 1) +
-             values.at(values.size() / 2)) / 2.0;
+      LubyLevel* lvl = m_levels.at(n);
+      if (lvl->rep == m_myid && lvl->value_stale) {
+        // I'm the level-n rep, so I should calculate the value for this
+        // level-n group from my level-n-1 group's value and the values
+        // of my level-n-1 peer groups
+        double value = AggregateLevel(n);
+        lvl->value_stale = false;
+        if (value != lvl->rep_value && n + 1 < m_levels.size()) {
+          m_levels.at(n + 1)->value_stale = true;
         }
-        values.clear();
+        lvl->rep_value = value;
+      }
+    }
+  }
+
+  double LubyMIS::AggregateLevel(uint32_t n) {
+    LubyLevel* below = m_levels.at(n-1);
+    const LubyPeerTable &peers = below->peers;
+
+    if (m_aggregate == AGGREGATE_WEIGHTED_MEDIAN) {
+      // reps don't learn how big peer groups are; a group's degree is
+      // the size hint they do have
+      m_weighted_values.clear();
+      m_weighted_values.push_back(std::make_pair(below->rep_value,
+                                                 (uint32_t)below->peers.size() + 1));
+      uint64_t total = below->peers.size() + 1;
+      for(uint32_t i = 0; i < peers.size(); i++) {
+        m_weighted_values.push_back(std::make_pair(peers.value[i],
+                                                   peers.degree[i] + 1));
+        total += peers.degree[i] + 1;
+      }
+      std::sort(m_weighted_values.begin(), m_weighted_values.end());
+      uint64_t seen = 0;
+      for(uint32_t i = 0; i < m_weighted_values.size(); i++) {
+        seen += m_weighted_values[i].second;
+        if (2 * seen >= total) return m_weighted_values[i].first;
       }
+      return m_weighted_values.back().first;
     }
+
+    m_values.clear();
+    m_values.push_back(below->rep_value);
+    m_values.insert(m_values.end(), peers.value.begin(), peers.value.end());
+    uint32_t size = m_values.size();
+
+    if (m_aggregate == AGGREGATE_TRIMMED_MEAN) {
+      uint32_t trim = (uint32_t)(m_trim * size);
+      if (2 * trim >= size) trim = (size - 1) / 2;
+      std::vector<double>::iterator lo = m_values.begin() + trim;
+      std::vector<double>::iterator hi = m_values.end() - trim;
+      if (trim > 0) {
+        std::nth_element(m_values.begin(), lo, m_values.end());
+        std::nth_element(lo, hi, m_values.end());
+      }
+      double sum = 0;
+      for(std::vector<double>::iterator v = lo; v != hi; v++) {
+        sum += *v;
+      }
+      return sum / (hi - lo);
+    }
+
+    // median: select the upper middle; for an even count the lower
+    // middle is then the largest value below it
+    std::vector<double>::iterator mid = m_values.begin() + size / 2;
+    std::nth_element(m_values.begin(), mid, m_values.end());
+    if (size % 2 == 1) return *mid;
+    return (*std::max_element(m_values.begin(), mid) + *mid) / 2.0;
   }
 
   void LubyMIS::LogMemory() {
     NS_LOG_FUNCTION(this);
-    Ipv4Address me(m_myaddr);
     Ipv4Address p;
     Ipv4Address hop;
     NS_LOG_INFO("memory: msg_sz=" << GetMarshalledSize() <<
-                " m_myaddr=" << me <<
-                " m_value=" << m_value);
+                " m_myid=" << m_myid <<
+                " m_myip=" << m_myip <<
+                " m_value=" << m_value <<
+                " msgs_skipped=" << m_msgs_skipped);
     for(uint32_t n = 0; n < m_levels.size(); n++) {
-      Ipv4Address a(m_levels.at(n)->rep);
+      Ipv4Address a = GetIpv4Address(m_levels.at(n)->rep);
       NS_LOG_INFO("memory: level=" << n <<
                   " rep=" << a <<
                   " rep_value=" << m_levels.at(n)->rep_value <<
                   " #peers=" << m_levels.at(n)->peers.size());
-      uint32_t i = 0;
-      std::map<uint32_t, LubyPeer*>::iterator it;
-      for(it = m_levels.at(n)->peers.begin();
-          it != m_levels.at(n)->peers.end(); it++) {
-        p.Set(it->first);
-        hop.Set(it->second->next_hop);
+      const LubyPeerTable &peers = m_levels.at(n)->peers;
+      for(uint32_t i = 0; i < peers.size(); i++) {
+        p = GetIpv4Address(peers.id[i]);
+        hop = GetIpv4Address(peers.next_hop[i]);
         NS_LOG_INFO("  peer " << i << ": " << p << 
-                    " (distance " << it->second->dist << " via " << hop
+                    " (distance " << peers.dist[i] << " via " << hop
                     << ")");
-        i++;
       }
     }
   }
 
+  void LubyMIS::SetMyNodeId(uint32_t node_id) {
+    NS_LOG_FUNCTION(this << node_id);
+    m_myid = node_id + 1;
+  }
+
   void LubyMIS::SetMyIpv4Address(Ipv4Address me) {
     NS_LOG_FUNCTION(this);
-    uint32_t addr = me.Get();
-    m_myaddr = addr;
-    m_myip.Set(m_myaddr);
-    m_levels.at(0)->rep = addr;
+    NS_ASSERT_MSG(m_myid != 0, "SetMyNodeId must come first");
+    m_myip = me;
+    if (g_ipv4_by_id.size() <= m_myid) g_ipv4_by_id.resize(m_myid + 1, 0);
+    g_ipv4_by_id[m_myid] = me.Get();
+    m_levels.at(0)->rep = m_myid;
     m_levels.at(0)->rep_value = m_value;
+    StateChanged();
+  }
+
+  void LubyMIS::NeighborDown(uint32_t node_id) {
+    NS_LOG_FUNCTION(this << node_id);
+    DropNeighbor(node_id + 1);
+  }
+
+  void LubyMIS::DropNeighbor(uint32_t id) {
+    NS_LOG_FUNCTION(this << id);
+    // same as hearing from the neighbor that it has no levels at all:
+    // everything learned through it goes away
+    std::vector<LubyLevel*> no_levels;
+    TrimVacatedLeadersAndPeers(id, no_levels);
+    m_sender_digests.erase(id);
+    StateChanged();
+  }
+
+  void LubyMIS::Reset() {
+    NS_LOG_FUNCTION(this);
+    for(std::vector<LubyLevel *>::iterator it = m_levels.begin();
+        it != m_levels.end(); it++) {
+      delete (*it);
+    }
+    m_levels.clear();
+    LubyLevel* level0 = new LubyLevel();
+    level0->level = 0;
+    m_levels.push_back(level0);
+    SetMyIpv4Address(m_myip);
+    m_last_heard.clear();
+    m_liveness.Clear();
+    m_sender_digests.clear();
+    StateChanged();
+  }
+
+  // A snapshot is my value, then my state as I would send it, then the
+  // per-level rep_next_hop that never goes on the wire.
+  uint32_t LubyMIS::GetSnapshotSize() {
+    NS_LOG_FUNCTION(this);
+    uint32_t sz = sizeof(m_value) + GetMarshalledSize();
+    for(std::vector<LubyLevel*>::iterator it = m_levels.begin();
+        it != m_levels.end(); it++) {
+      sz += VarintSize((*it)->rep_next_hop);
+    }
+    return sz;
+  }
+
+  void LubyMIS::SnapshotTo(uint8_t const *buf) {
+    NS_LOG_FUNCTION(this);
+    uint8_t *dst = (uint8_t *)buf;
+    memcpy(dst, &m_value, sizeof(m_value));
+    dst += sizeof(m_value);
+    MarshalTo(dst);
+    dst += GetMarshalledSize();
+    for(std::vector<LubyLevel*>::iterator it = m_levels.begin();
+        it != m_levels.end(); it++) {
+      dst = PutVarint(dst, (*it)->rep_next_hop);
+    }
+  }
+
+  void LubyMIS::RestoreFrom(uint8_t const *buf) {
+    NS_LOG_FUNCTION(this);
+    const uint8_t *src = buf;
+    memcpy(&m_value, src, sizeof(m_value));
+    src += sizeof(m_value);
+    uint32_t num_levels;
+    src = GetVarint(src, &m_myid);
+    src = GetVarint(src, &num_levels);
+    m_myip = GetIpv4Address(m_myid);
+
+    for(std::vector<LubyLevel *>::iterator it = m_levels.begin();
+        it != m_levels.end(); it++) {
+      delete (*it);
+    }
+    m_levels.clear();
+    while(num_levels > 0) {
+      uint32_t len;
+      LubyLevel* lvl = LubyLevel::MarshalFrom(src, &len);
+      src += len;
+      m_levels.push_back(lvl);
+      num_levels--;
+    }
+    for(std::vector<LubyLevel*>::iterator it = m_levels.begin();
+        it != m_levels.end(); it++) {
+      src = GetVarint(src, &((*it)->rep_next_hop));
+    }
+
+    // give every restored neighbor a full timeout to speak up
+    m_last_heard.clear();
+    m_liveness.Clear();
+    const LubyPeerTable &peers0 = m_levels.at(0)->peers;
+    for(uint32_t i = 0; i < peers0.size(); i++) {
+      HeardFrom(peers0.id[i]);
+    }
+    m_sender_digests.clear();
+    StateChanged();
   }
 
   LubyMISFactory::LubyMISFactory(bool d3_output) {
     m_d3_output = d3_output;
+    m_aggregate = LubyMIS::AGGREGATE_MEDIAN;
+    m_trim = 0.0;
+    m_segment_priority = LubyMIS::SEGMENT_BY_LEVEL;
   }
   LubyMISFactory::~LubyMISFactory() {}
 
   DmcData* LubyMISFactory::Create() {
-    return new LubyMIS(m_d3_output);
+    LubyMIS* out = new LubyMIS(m_d3_output);
+    out->SetPeerTimeout(m_peer_timeout);
+    out->SetChangeCallback(m_on_change);
+    out->SetAggregate(m_aggregate, m_trim);
+    out->SetSegmentPriority(m_segment_priority);
+    return out;
+  }
+
+  void LubyMISFactory::SetPeerTimeout(Time timeout) {
+    m_peer_timeout = timeout;
+  }
+
+  void LubyMISFactory::SetChangeCallback(LubyMIS::ChangeCallback cb) {
+    m_on_change = cb;
+  }
+
+  void LubyMISFactory::SetAggregate(LubyMIS::Aggregate aggregate,
+                                    double trim) {
+    m_aggregate = aggregate;
+    m_trim = trim;
+  }
+
+  void LubyMISFactory::SetSegmentPriority(LubyMIS::SegmentPriority priority) {
+    m_segment_priority = priority;
   }
 }
@@ -21,27 +21,27 @@
 #include <vector>
 #include <utility>
 #include "ns3/ipv4-address.h"
+#include "ns3/nstime.h"
+#include "ns3/callback.h"
 #include "dmc-data.h"
+#include "luby-peer-table.h"
+#include "timer-wheel.h"
 
 namespace ns3 {
 
-  class LubyPeer {
-  public:
-    uint32_t degree;
-    double value;
-    uint32_t next_hop;
-    uint32_t dist;
-  };
-
+  // Nodes are known by dense ids rather than IPv4 addresses: a node's
+  // id is its ns-3 node id plus one, so that 0 still means "none".  Ids
+  // and the other small integers go on the wire as varints.
   class LubyLevel {
   public:
     LubyLevel();
-    ~LubyLevel();
     uint32_t MaxPeerDistance();
+    static uint32_t MaxPeerDistance(uint32_t level);
 
-    uint32_t GetMarshalledSize();
+    uint32_t GetMarshalledSize() const;
     uint8_t* MarshalTo(const uint8_t *buf);
-    static LubyLevel* MarshalFrom(const uint8_t *buf);
+    static LubyLevel* MarshalFrom(const uint8_t *buf, uint32_t *len);
+    static uint32_t MarshalledSizeAt(const uint8_t *buf);
     void ResetPeers();
     void ResetRep();
 
@@ -50,23 +50,101 @@ namespace ns3 {
     uint32_t rep_next_hop;
     uint32_t rep_dist;
     double rep_value;
-    std::map<uint32_t, LubyPeer*> peers;
+    bool value_stale; // level below changed since rep_value was computed
+    LubyPeerTable peers;
+  };
+
+  // A possible level-n rep as seen from a node: its own level n-1 rep or
+  // one of its level n-1 peers, with that group's degree.
+  struct LubyCandidate {
+    uint32_t id;
+    uint32_t degree;
+  };
+
+  // Election rankings: Better(a, b) says whether a should replace b as
+  // my rep.  Pick one at compile time with LUBY_ELECTION_RANKING.
+
+  // Luby's rule: the group with more peer groups wins, then the lower
+  // id.
+  struct DegreeThenIdRanking {
+    static bool Better(const LubyCandidate &a, const LubyCandidate &b) {
+      if (a.degree != b.degree) return a.degree > b.degree;
+      return a.id < b.id;
+    }
+  };
+
+  // Ignore degree: the lowest id wins.
+  struct LowestIdRanking {
+    static bool Better(const LubyCandidate &a, const LubyCandidate &b) {
+      return a.id < b.id;
+    }
   };
 
+#ifndef LUBY_ELECTION_RANKING
+#define LUBY_ELECTION_RANKING DegreeThenIdRanking
+#endif
+  typedef LUBY_ELECTION_RANKING LubyElectionRanking;
+
   class LubyMIS : public DmcData {
     
   public:
+    typedef Callback<void, LubyMIS*> ChangeCallback;
+
+    // How a rep combines its own group's value with its peer groups'
+    enum Aggregate {
+      AGGREGATE_MEDIAN,
+      AGGREGATE_TRIMMED_MEAN,   // mean without the top and bottom trim
+      AGGREGATE_WEIGHTED_MEDIAN // groups weighted by degree + 1
+    };
+
+    // Which segments of a message that doesn't fit one packet go first
+    enum SegmentPriority {
+      SEGMENT_BY_LEVEL,  // lowest level first
+      SEGMENT_BY_RECENCY // most recently changed level first
+    };
+
     LubyMIS(bool d3_output);
     virtual ~LubyMIS();
+    static const char* GetProtocolName();
     
-    uint32_t GetMarshalledSize();
+    uint32_t GetMarshalledSize() const;
     void MarshalTo(uint8_t const *buf);
     void MarshalFrom(uint8_t const *buf);
     void LogMemory();
+    void SetMyNodeId(uint32_t node_id);
     void SetMyIpv4Address(Ipv4Address me);
+    void NeighborDown(uint32_t node_id);
+    void Reset();
+    void PrepareToSend();
+    uint32_t GetSnapshotSize();
+    void SnapshotTo(uint8_t const *buf);
+    void RestoreFrom(uint8_t const *buf);
+    void Segment(uint8_t const *buf, uint32_t size, uint32_t max_bytes,
+                 std::vector<DmcSegment> &segments);
+
+    // Forget a direct neighbor (and everything learned through it) if we
+    // haven't heard from it for this long; zero disables expiry.
+    void SetPeerTimeout(Time timeout);
+
+    // Called whenever the hierarchy structure (levels, reps, peers and
+    // their routes and degrees, but not values) changes; costs a digest
+    // of the state after every update while set.
+    void SetChangeCallback(ChangeCallback cb);
+
+    // trim is the fraction dropped from each end for a trimmed mean
+    void SetAggregate(Aggregate aggregate, double trim);
+
+    void SetSegmentPriority(SegmentPriority priority);
+
+    uint32_t GetId() const;
+    const std::vector<LubyLevel*>& GetLevels() const;
+
+    // The address a node id was registered with, for logging; 0.0.0.0
+    // until that node has been given its address
+    static Ipv4Address GetIpv4Address(uint32_t id);
 
   private:
-    void AppendIpv4AddressAsString(char *buf, uint32_t addr);
+    void AppendIpv4AddressAsString(char *buf, uint32_t id);
     void ProcessTopologyChanges(uint32_t sender,
                                 std::vector<LubyLevel*> msg_levels,
                                 uint32_t n);
@@ -77,17 +155,56 @@ namespace ns3 {
     void HandleRepElection(uint32_t sender,
                            std::vector<LubyLevel*> msg_levels,
                            uint32_t n);
+    bool GetCandidate(uint32_t n, uint32_t id, LubyCandidate *out) const;
     void TryToBecomeRep();
     void UpdatePeerValues(uint32_t sender, std::vector<LubyLevel*> msg_levels);
     void RecalculateLevelValues();
+    double AggregateLevel(uint32_t n);
     void DumpState(const char *label);
     void DumpMessage(uint32_t sender, std::vector<LubyLevel*> msg_levels);
+    void HeardFrom(uint32_t sender);
+    void ExpireSilentNeighbors();
+    void DropNeighbor(uint32_t id);
+    uint64_t Digest(bool with_values) const;
+    static uint64_t MessageDigest(const uint8_t *buf);
+    void StateChanged();
+    void NotifyIfChanged();
+    uint64_t SegmentRank(uint32_t n) const;
 
-    uint32_t m_myaddr;
+    uint32_t m_myid;
     Ipv4Address m_myip;
     double m_value;
     std::vector<LubyLevel*> m_levels;
     bool m_d3_output;
+    Time m_peer_timeout;
+    std::map<uint32_t, Time> m_last_heard; // direct neighbor -> time
+    TimerWheel m_liveness;
+    ChangeCallback m_on_change;
+    uint64_t m_structure_digest;
+
+    // A sender's last message, and my state digest before and after I
+    // processed it
+    struct SenderDigest {
+      uint64_t message;
+      uint64_t state_before;
+      uint64_t state_after;
+    };
+    std::map<uint32_t, SenderDigest> m_sender_digests;
+    uint64_t m_state_digest; // Digest(true), kept current
+    uint64_t m_msgs_skipped;
+    Aggregate m_aggregate;
+    double m_trim;
+    std::vector<double> m_values; // reused by AggregateLevel
+    std::vector<std::pair<double, uint32_t> > m_weighted_values;
+    std::vector<uint32_t> m_selected; // reused for peer table scans
+    LubyPeerTable m_merged;           // reused by the same-group merge
+    SegmentPriority m_segment_priority;
+    // Recency for Segment: each level's digest as last segmented, and
+    // the m_segmented count when that digest last changed
+    uint64_t m_segmented;
+    std::vector<uint64_t> m_level_digests;
+    std::vector<uint64_t> m_level_changed;
+    std::vector<std::pair<uint32_t, uint32_t> > m_records; // reused by Segment
   };
 
   class LubyMISFactory : public DmcDataFactory {
@@ -97,9 +214,18 @@ namespace ns3 {
     ~LubyMISFactory();
 
     DmcData* Create();
+    void SetPeerTimeout(Time timeout);
+    void SetChangeCallback(LubyMIS::ChangeCallback cb);
+    void SetAggregate(LubyMIS::Aggregate aggregate, double trim);
+    void SetSegmentPriority(LubyMIS::SegmentPriority priority);
 
   private:
     bool m_d3_output;
+    Time m_peer_timeout;
+    LubyMIS::ChangeCallback m_on_change;
+    LubyMIS::Aggregate m_aggregate;
+    double m_trim;
+    LubyMIS::SegmentPriority m_segment_priority;
   };
 }
 
@@ -0,0 +1,156 @@
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <algorithm>
+#include "ns3/assert.h"
+#include "luby-peer-table.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ns3 {
+
+  // Append to out the indices i < n where v[i] == key
+  static void SelectEqual(const uint32_t *v, uint32_t n, uint32_t key,
+                          std::vector<uint32_t> *out) {
+    uint32_t i = 0;
+#if defined(__AVX2__)
+    __m256i key8 = _mm256_set1_epi32(key);
+    for(; i + 8 <= n; i += 8) {
+      __m256i x = _mm256_loadu_si256((const __m256i *)(v + i));
+      uint32_t mask = _mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpeq_epi32(x, key8)));
+      while(mask) {
+        out->push_back(i + __builtin_ctz(mask));
+        mask &= mask - 1;
+      }
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i key4 = _mm_set1_epi32(key);
+    for(; i + 4 <= n; i += 4) {
+      __m128i x = _mm_loadu_si128((const __m128i *)(v + i));
+      uint32_t mask = _mm_movemask_ps(
+        _mm_castsi128_ps(_mm_cmpeq_epi32(x, key4)));
+      while(mask) {
+        out->push_back(i + __builtin_ctz(mask));
+        mask &= mask - 1;
+      }
+    }
+#endif
+    for(; i < n; i++) {
+      if (v[i] == key) out->push_back(i);
+    }
+  }
+
+  void LubyPeerTable::clear() {
+    id.clear();
+    degree.clear();
+    value.clear();
+    next_hop.clear();
+    dist.clear();
+  }
+
+  void LubyPeerTable::reserve(uint32_t n) {
+    id.reserve(n);
+    degree.reserve(n);
+    value.reserve(n);
+    next_hop.reserve(n);
+    dist.reserve(n);
+  }
+
+  void LubyPeerTable::swap(LubyPeerTable &other) {
+    id.swap(other.id);
+    degree.swap(other.degree);
+    value.swap(other.value);
+    next_hop.swap(other.next_hop);
+    dist.swap(other.dist);
+  }
+
+  uint32_t LubyPeerTable::Find(uint32_t peer) const {
+    std::vector<uint32_t>::const_iterator it =
+      std::lower_bound(id.begin(), id.end(), peer);
+    if (it == id.end() || *it != peer) return size();
+    return it - id.begin();
+  }
+
+  uint32_t LubyPeerTable::Insert(uint32_t peer, uint32_t peer_degree,
+                                 double peer_value, uint32_t peer_next_hop,
+                                 uint32_t peer_dist) {
+    uint32_t i = std::lower_bound(id.begin(), id.end(), peer) - id.begin();
+    NS_ASSERT(i == size() || id[i] != peer);
+    id.insert(id.begin() + i, peer);
+    degree.insert(degree.begin() + i, peer_degree);
+    value.insert(value.begin() + i, peer_value);
+    next_hop.insert(next_hop.begin() + i, peer_next_hop);
+    dist.insert(dist.begin() + i, peer_dist);
+    return i;
+  }
+
+  void LubyPeerTable::Append(uint32_t peer, uint32_t peer_degree,
+                             double peer_value, uint32_t peer_next_hop,
+                             uint32_t peer_dist) {
+    NS_ASSERT(id.empty() || id.back() < peer);
+    id.push_back(peer);
+    degree.push_back(peer_degree);
+    value.push_back(peer_value);
+    next_hop.push_back(peer_next_hop);
+    dist.push_back(peer_dist);
+  }
+
+  void LubyPeerTable::Erase(uint32_t i) {
+    id.erase(id.begin() + i);
+    degree.erase(degree.begin() + i);
+    value.erase(value.begin() + i);
+    next_hop.erase(next_hop.begin() + i);
+    dist.erase(dist.begin() + i);
+  }
+
+  void LubyPeerTable::Erase(const std::vector<uint32_t> &indices) {
+    if (indices.empty()) return;
+    // one compaction pass instead of shifting the tail once per peer
+    uint32_t out = indices[0];
+    uint32_t next = 0;
+    for(uint32_t i = indices[0]; i < size(); i++) {
+      if (next < indices.size() && indices[next] == i) {
+        next++;
+        continue;
+      }
+      id[out] = id[i];
+      degree[out] = degree[i];
+      value[out] = value[i];
+      next_hop[out] = next_hop[i];
+      dist[out] = dist[i];
+      out++;
+    }
+    id.resize(out);
+    degree.resize(out);
+    value.resize(out);
+    next_hop.resize(out);
+    dist.resize(out);
+  }
+
+  void LubyPeerTable::SelectNextHop(uint32_t hop,
+                                    std::vector<uint32_t> *out) const {
+    out->clear();
+    if (next_hop.empty()) return;
+    SelectEqual(&next_hop[0], next_hop.size(), hop, out);
+  }
+
+}
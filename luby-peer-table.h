@@ -0,0 +1,63 @@
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef _LUBY_PEER_TABLE_H
+#define _LUBY_PEER_TABLE_H
+
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+  /* The peers of one protocol level, sorted by id and stored as parallel
+     arrays.  Most per-message work is a filter over one field ("every
+     peer I reach through the sender"), which then reads a single flat
+     uint32_t array and runs on SSE2 or AVX2 when the compiler targets
+     them.  Indices stay valid until the next insert or erase. */
+  class LubyPeerTable {
+  public:
+    uint32_t size() const { return id.size(); }
+    bool empty() const { return id.empty(); }
+    void clear();
+    void reserve(uint32_t n);
+    void swap(LubyPeerTable &other);
+
+    // index of a peer, or size() if it isn't in the table
+    uint32_t Find(uint32_t peer) const;
+    bool Contains(uint32_t peer) const { return Find(peer) != size(); }
+
+    // Insert keeps the id order; Append needs ids to arrive in order
+    uint32_t Insert(uint32_t peer, uint32_t degree, double value,
+                    uint32_t next_hop, uint32_t dist);
+    void Append(uint32_t peer, uint32_t degree, double value,
+                uint32_t next_hop, uint32_t dist);
+    void Erase(uint32_t i);
+    // drop the peers at these indices, given in increasing order
+    void Erase(const std::vector<uint32_t> &indices);
+
+    // indices, in order, of the peers reached through hop
+    void SelectNextHop(uint32_t hop, std::vector<uint32_t> *out) const;
+
+    std::vector<uint32_t> id;
+    std::vector<uint32_t> degree;
+    std::vector<double> value;
+    std::vector<uint32_t> next_hop;
+    std::vector<uint32_t> dist;
+  };
+
+}
+
+#endif
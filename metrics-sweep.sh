@@ -0,0 +1,55 @@
+#!/bin/sh
+#
+# Copyright (C) 2015 Comcast Cable Communications Management, LLC
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+#
+# Run dmc at a range of network sizes and collect the hierarchy metrics
+# into one CSV, then print the network-wide scaling curves.  Run from the
+# top of the ns-3 tree, e.g.
+#
+#   NODES="100 1000 10000" SECS=60 OUT=scaling.csv ./scratch/metrics-sweep.sh
+#
+# Extra arguments are passed on to dmc.
+
+NODES=${NODES:-"50 100 200 400 800 1600"}
+SECS=${SECS:-30}
+INTERVAL=${INTERVAL:-0}
+OUT=${OUT:-metrics.csv}
+
+./waf build > /dev/null || exit 1
+
+rm -f "$OUT"
+for n in $NODES; do
+  ./waf --run "dmc --numNodes=$n --secsToRun=$SECS --metricsFile=$OUT \
+                   --metricsInterval=$INTERVAL $*" > /dev/null 2>&1 ||
+    echo "run with $n nodes failed" >&2
+done
+
+# last sample of each run, one column per network-wide metric
+awk -F, '
+  NR == 1 { next }
+  $4 == -1 { last[$1] = $2; v[$1 "," $2 "," $3] = $5; nodes[$1] = 1 }
+  END {
+    split("depth_mean depth_max state_bytes_mean state_bytes_p95 " \
+          "state_bytes_max msgs_per_node_s bytes_per_node_s", m, " ")
+    printf "%8s", "nodes"
+    for (i = 1; i in m; i++) printf " %16s", m[i]
+    printf "\n"
+    for (n in nodes) {
+      printf "%8s", n
+      for (i = 1; i in m; i++) printf " %16s", v[n "," last[n] "," m[i]]
+      printf "\n"
+    }
+  }' "$OUT" | sort -n
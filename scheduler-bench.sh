@@ -0,0 +1,49 @@
+#!/bin/sh
+#
+# Copyright (C) 2015 Comcast Cable Communications Management, LLC
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+#
+# Run the dmc workload under each event scheduler and tabulate events/s
+# and peak memory.  Run from the top of an ns-3 tree configured with
+# --build-profile=optimized, e.g.
+#
+#   NODES="1000 10000" SECS=20 ./scratch/scheduler-bench.sh
+#
+# Extra arguments are passed on to dmc.
+
+SCHEDULERS=${SCHEDULERS:-"Map Heap List Calendar Bucket"}
+NODES=${NODES:-"100 1000 10000"}
+SECS=${SECS:-10}
+
+# build once so compile time doesn't land in the first measurement
+./waf build > /dev/null || exit 1
+
+printf "%-9s %7s %12s %11s %12s %10s %12s\n" \
+  scheduler nodes events peak_queue events_per_s run_ms peak_rss_kb
+for n in $NODES; do
+  for s in $SCHEDULERS; do
+    line=$(./waf --run "dmc --numNodes=$n --secsToRun=$SECS \
+                            --scheduler=$s --schedulerStats $*" 2>&1 |
+           grep '^scheduler:')
+    if [ -z "$line" ]; then
+      echo "$s with $n nodes failed" >&2
+      continue
+    fi
+    field() { echo "$line" | sed -n "s/.* $1=\([^ ]*\).*/\1/p"; }
+    printf "%-9s %7s %12s %11s %12s %10s %12s\n" "$s" "$n" \
+      "$(field events)" "$(field peak_queue)" "$(field events_per_s)" \
+      "$(field run_ms)" "$(field peak_rss_kb)"
+  done
+done
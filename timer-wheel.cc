@@ -0,0 +1,70 @@
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "ns3/log.h"
+#include "timer-wheel.h"
+
+namespace ns3 {
+
+  NS_LOG_COMPONENT_DEFINE("TimerWheel");
+
+  TimerWheel::TimerWheel() {
+    m_current = 0;
+  }
+
+  TimerWheel::TimerWheel(Time tick, uint32_t num_slots) {
+    NS_ASSERT(tick.IsStrictlyPositive() && num_slots > 1);
+    m_tick = tick;
+    m_current = 0;
+    m_slots.resize(num_slots);
+  }
+
+  int64_t TimerWheel::TickOf(Time t) {
+    return t.GetTimeStep() / m_tick.GetTimeStep();
+  }
+
+  void TimerWheel::Schedule(uint32_t key, Time deadline) {
+    NS_LOG_FUNCTION(this << key << deadline);
+    int64_t tick = TickOf(deadline);
+    int64_t last = m_current + (int64_t)m_slots.size() - 1;
+    if (tick <= m_current) tick = m_current + 1;
+    if (tick > last) tick = last;
+    m_slots[tick % m_slots.size()].push_back(key);
+  }
+
+  void TimerWheel::Advance(Time now, std::vector<uint32_t> &due) {
+    NS_LOG_FUNCTION(this << now);
+    int64_t target = TickOf(now);
+    if (target <= m_current) return;
+    // a long gap still only needs one turn of the wheel
+    if (target - m_current > (int64_t)m_slots.size()) {
+      m_current = target - m_slots.size();
+    }
+    while (m_current < target) {
+      m_current++;
+      std::vector<uint32_t> &slot = m_slots[m_current % m_slots.size()];
+      due.insert(due.end(), slot.begin(), slot.end());
+      slot.clear();
+    }
+  }
+
+  void TimerWheel::Clear() {
+    for(uint32_t i = 0; i < m_slots.size(); i++) {
+      m_slots[i].clear();
+    }
+  }
+
+}
@@ -0,0 +1,52 @@
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef _TIMER_WHEEL_H
+#define _TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+  /* Hashed timer wheel for soft-state expiry.  Keys are filed in the slot
+     for their deadline and handed back by Advance() once the clock has
+     passed that slot; nothing is scheduled with the simulator.  Re-arming
+     is left to the caller: it keeps its own "last heard" times and, when
+     a key comes back early (it was refreshed after being filed), simply
+     schedules it again.  Deadlines beyond the wheel's span are filed in
+     the furthest slot and come back for another look. */
+  class TimerWheel {
+  public:
+    TimerWheel();
+    TimerWheel(Time tick, uint32_t num_slots);
+
+    void Schedule(uint32_t key, Time deadline);
+    void Advance(Time now, std::vector<uint32_t> &due);
+    void Clear();
+
+  private:
+    int64_t TickOf(Time t);
+
+    Time m_tick;
+    int64_t m_current;          // last tick processed
+    std::vector<std::vector<uint32_t> > m_slots;
+  };
+
+}
+
+#endif
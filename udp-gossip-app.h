@@ -0,0 +1,106 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/* 
+ * Copyright (C) 2015 Comcast Cable Communications Management, LLC
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef UDP_GOSSIP_APP_H
+#define UDP_GOSSIP_APP_H
+
+#include <string>
+#include <vector>
+#include "ns3/assert.h"
+#include "ns3/udp-gossip.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup udpgossip
+ * \brief A UdpGossip specialized for one protocol type
+ *
+ * The plain application reaches its protocol through DmcData, which
+ * takes several virtual calls per message.  This one makes a single
+ * virtual call per message (EncodeState or DecodeState).  It then calls
+ * Protocol's own PrepareToSend, GetMarshalledSize, MarshalTo and
+ * MarshalFrom by
+ * qualified name, so they are bound statically and can be inlined.
+ * Everything else still goes through DmcData.
+ *
+ * Protocol must derive from DmcData, be what the installed
+ * DmcDataFactory creates, and provide a static GetProtocolName() that
+ * names its TypeId.
+ */
+template <class Protocol>
+class UdpGossipApp : public UdpGossip
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId, ns3::UdpGossipApp<name>
+   */
+  static TypeId GetTypeId (void);
+
+protected:
+  virtual uint32_t EncodeState (std::vector<uint8_t> &buf);
+  virtual void DecodeState (const uint8_t *buf);
+
+private:
+  Protocol *GetProtocol (void) const;
+};
+
+template <class Protocol>
+TypeId
+UdpGossipApp<Protocol>::GetTypeId (void)
+{
+  static std::string name = (std::string ("ns3::UdpGossipApp<") +
+                             Protocol::GetProtocolName () + ">");
+  static TypeId tid = TypeId (name.c_str ())
+    .SetParent<UdpGossip> ()
+    .AddConstructor<UdpGossipApp<Protocol> > ()
+  ;
+  return tid;
+}
+
+template <class Protocol>
+Protocol *
+UdpGossipApp<Protocol>::GetProtocol (void) const
+{
+  NS_ASSERT_MSG (dynamic_cast<Protocol *> (GetDmcData ()) != 0,
+                 "protocol state is not a " << Protocol::GetProtocolName ());
+  return static_cast<Protocol *> (GetDmcData ());
+}
+
+template <class Protocol>
+uint32_t
+UdpGossipApp<Protocol>::EncodeState (std::vector<uint8_t> &buf)
+{
+  Protocol *protocol = GetProtocol ();
+  protocol->Protocol::PrepareToSend ();
+  uint32_t bufsz = protocol->Protocol::GetMarshalledSize ();
+  buf.resize (bufsz);
+  protocol->Protocol::MarshalTo (&buf[0]);
+  return bufsz;
+}
+
+template <class Protocol>
+void
+UdpGossipApp<Protocol>::DecodeState (const uint8_t *buf)
+{
+  GetProtocol ()->Protocol::MarshalFrom (buf);
+}
+
+} // namespace ns3
+
+#endif /* UDP_GOSSIP_APP_H */
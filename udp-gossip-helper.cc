@@ -32,6 +32,12 @@ UdpGossipHelper::UdpGossipHelper (uint16_t port, bool d3_output,
   m_dmc_factory = fact;
 }
 
+void
+UdpGossipHelper::SetTypeId (TypeId tid)
+{
+  m_factory.SetTypeId (tid);
+}
+
 void 
 UdpGossipHelper::SetAttribute (
   std::string name, 
@@ -63,6 +69,55 @@ UdpGossipHelper::Install (NodeContainer nodes) const
   return out;
 }
 
+ApplicationContainer
+UdpGossipHelper::Install (NodeContainer nodes, const LinkList &links,
+                         const NetDeviceContainer &devices,
+                         const Ipv4InterfaceContainer &interfaces) const
+{
+  NS_ASSERT_MSG (devices.GetN() == 2 * links.size(),
+                 "expected two devices per link");
+  bool have_ip = interfaces.GetN() > 0;
+  NS_ASSERT_MSG (!have_ip || interfaces.GetN() == devices.GetN(),
+                 "expected one address per link device");
+
+  std::vector<uint32_t> degree(nodes.GetN(), 0);
+  for(uint32_t e=0; e < links.size(); e++) {
+    degree[links[e].first]++;
+    degree[links[e].second]++;
+  }
+  std::vector<std::vector<UdpGossipNeighbor> > tables(nodes.GetN());
+  for(uint32_t n=0; n < nodes.GetN(); n++) {
+    tables[n].reserve(degree[n]);
+  }
+
+  // devices are added to nodes in link order, so each table comes out
+  // in its node's device order
+  for(uint32_t e=0; e < links.size(); e++) {
+    uint32_t ends[2] = { links[e].first, links[e].second };
+    for(uint32_t side=0; side < 2; side++) {
+      uint32_t other = 1 - side;
+      Ptr<Node> peer_node = nodes.Get(ends[other]);
+      UdpGossipNeighbor peer;
+      peer.addr = have_ip ? interfaces.GetAddress(2 * e + other)
+                          : UdpGossip::GetSomeAddrOf(peer_node);
+      peer.node_id = peer_node->GetId();
+      peer.dev = devices.Get(2 * e + side);
+      peer.up = true;
+      tables[ends[side]].push_back(peer);
+    }
+  }
+
+  ApplicationContainer out;
+  for(uint32_t n=0; n < nodes.GetN(); n++) {
+    Ptr<UdpGossip> udp = m_factory.Create<UdpGossip>();
+    udp->SetDmcDataFactory(m_dmc_factory);
+    udp->SetNeighbors(tables[n]);
+    nodes.Get(n)->AddApplication(udp);
+    out.Add(udp);
+  }
+  return out;
+}
+
 Ptr<Application>
 UdpGossipHelper::InstallPriv (Ptr<Node> node) const
 {
@@ -19,8 +19,12 @@
 #define UDP_GOSSIP_HELPER_H
 
 #include <stdint.h>
+#include <vector>
+#include <utility>
 #include "ns3/application-container.h"
 #include "ns3/node-container.h"
+#include "ns3/net-device-container.h"
+#include "ns3/ipv4-interface-container.h"
 #include "ns3/object-factory.h"
 #include "ns3/ipv4-address.h"
 #include "ns3/ipv6-address.h"
@@ -28,6 +32,10 @@
 
 namespace ns3 {
 
+// udp-gossip-app.h, which needs to be included wherever
+// UdpGossipAppHelper is used
+template <class Protocol> class UdpGossipApp;
+
 /**
  * \ingroup udpgossip
  * \brief Gossip protocols
@@ -35,6 +43,11 @@ namespace ns3 {
 class UdpGossipHelper
 {
 public:
+  /**
+   * Point-to-point links as pairs of indices into a NodeContainer
+   */
+  typedef std::vector<std::pair<uint32_t, uint32_t> > LinkList;
+
   /**
    * Create UdpGossipHelper which will make life easier for people trying
    * to set up simulations with UDP gossip protocols.
@@ -76,6 +89,31 @@ public:
 
   ApplicationContainer Install (NodeContainer nodes) const;
 
+  /**
+   * Create a UdpGossipApplication on every node, handing each one its
+   * neighbor table instead of having it walk its devices at startup.
+   * The tables for all nodes are built in one pass over the links, and
+   * the protocol state of each node is only created when it starts.
+   *
+   * \param nodes The nodes to install on
+   * \param links The links, in the order their devices were installed
+   * \param devices The link devices, two per link in link order
+   * \param interfaces The addresses assigned to devices, in the same
+   *        order, or an empty container if the nodes have no internet stack
+   *
+   * \returns An ApplicationContainer holding the Applications created,
+   *          in node order.
+   */
+  ApplicationContainer Install (NodeContainer nodes, const LinkList &links,
+                                const NetDeviceContainer &devices,
+                                const Ipv4InterfaceContainer &interfaces) const;
+
+protected:
+  /**
+   * \brief Install applications of this type instead of ns3::UdpGossip
+   */
+  void SetTypeId (TypeId tid);
+
 private:
   /**
    * Install an ns3::UdpGossip on the node configured with all the
@@ -91,6 +129,23 @@ private:
   DmcDataFactory* m_dmc_factory;
 };
 
+/**
+ * \ingroup udpgossip
+ * \brief Installs UdpGossipApp<Protocol> instead of the generic UdpGossip
+ *
+ * fact must create Protocol objects.
+ */
+template <class Protocol>
+class UdpGossipAppHelper : public UdpGossipHelper
+{
+public:
+  UdpGossipAppHelper (uint16_t port, bool d3_output, DmcDataFactory* fact)
+    : UdpGossipHelper (port, d3_output, fact)
+  {
+    SetTypeId (UdpGossipApp<Protocol>::GetTypeId ());
+  }
+};
+
 } // namespace ns3
 
 #endif /* UDP_GOSSIP_HELPER_H */
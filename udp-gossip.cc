@@ -15,6 +15,7 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
+#include <algorithm>
 #include "ns3/log.h"
 #include "ns3/ipv4-address.h"
 #include "ns3/ipv6-address.h"
@@ -27,6 +28,10 @@
 #include "ns3/packet.h"
 #include "ns3/uinteger.h"
 #include "ns3/trace-source-accessor.h"
+#include "ns3/enum.h"
+#include "ns3/double.h"
+#include "ns3/node-list.h"
+#include "gossip-header.h"
 #include "udp-gossip.h"
 
 namespace ns3 {
@@ -35,6 +40,11 @@ NS_LOG_COMPONENT_DEFINE ("UdpGossipApplication");
 
 NS_OBJECT_ENSURE_REGISTERED (UdpGossip);
 
+// PointToPointNetDevice only knows how to frame IPv4 and IPv6, so raw
+// gossip frames borrow the IPv4 protocol number.  That is why the raw
+// transport cannot share a node with an installed internet stack.
+static const uint16_t GOSSIP_RAW_PROTOCOL = 0x0800;
+
 TypeId
 UdpGossip::GetTypeId (void)
 {
@@ -56,6 +66,49 @@ UdpGossip::GetTypeId (void)
                    BooleanValue (false),
                    MakeBooleanAccessor (&UdpGossip::m_d3_output),
                    MakeBooleanChecker())
+    .AddAttribute ("SingleSocket",
+                   "Whether to send to every peer with SendTo on the one "
+                   "receive socket instead of a connected socket per peer",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&UdpGossip::m_single_socket),
+                   MakeBooleanChecker())
+    .AddAttribute ("Transport",
+                   "How messages reach peers: UDP sockets, raw frames on "
+                   "the link device, or an ideal channel",
+                   EnumValue (TRANSPORT_UDP),
+                   MakeEnumAccessor (&UdpGossip::m_transport),
+                   MakeEnumChecker (TRANSPORT_UDP, "Udp",
+                                    TRANSPORT_RAW, "Raw",
+                                    TRANSPORT_IDEAL, "Ideal"))
+    .AddAttribute ("IdealDelay",
+                   "One-way delivery delay of the ideal transport",
+                   TimeValue (MilliSeconds (2)),
+                   MakeTimeAccessor (&UdpGossip::m_ideal_delay),
+                   MakeTimeChecker ())
+    .AddAttribute ("IdealLossRate",
+                   "Probability that the ideal transport drops a message",
+                   DoubleValue (0.0),
+                   MakeDoubleAccessor (&UdpGossip::m_ideal_loss),
+                   MakeDoubleChecker<double> (0.0, 1.0))
+    .AddAttribute ("Mtu",
+                   "Largest packet a message segment may fill, counting "
+                   "the IPv4 and UDP headers, or the gossip header of a "
+                   "raw frame",
+                   UintegerValue (1500),
+                   MakeUintegerAccessor (&UdpGossip::m_mtu),
+                   MakeUintegerChecker<uint32_t> (68))
+    .AddAttribute ("MaxSegments",
+                   "Most packets one message may be split into; bigger "
+                   "messages are not sent",
+                   UintegerValue (64),
+                   MakeUintegerAccessor (&UdpGossip::m_max_segments),
+                   MakeUintegerChecker<uint32_t> (1, 65535))
+    .AddAttribute ("SegmentGap",
+                   "Time between the packets of a message that takes "
+                   "more than one",
+                   TimeValue (MicroSeconds (100)),
+                   MakeTimeAccessor (&UdpGossip::m_segment_gap),
+                   MakeTimeChecker ())
     .AddTraceSource ("Tx", "A new packet is created and is sent",
                      MakeTraceSourceAccessor (&UdpGossip::m_txTrace),
                      "ns3::Packet::TracedCallback")
@@ -67,18 +120,29 @@ UdpGossip::UdpGossip ()
 {
   NS_LOG_FUNCTION (this);
   m_sent = 0;
+  m_sent_bytes = 0;
+  m_rx_unknown = 0;
+  m_mtu = 1500;
+  m_max_segments = 64;
+  m_tx_seq = 0;
+  m_tx_oversize = 0;
+  m_rx_incomplete = 0;
+  m_node_up = true;
+  m_single_socket = false;
+  m_transport = TRANSPORT_UDP;
+  m_peers_discovered = false;
+  m_running = false;
+  m_restored = false;
+  m_loss_rv = CreateObject<UniformRandomVariable> ();
   m_sendEvent = EventId();
+  m_dmc_data = 0;
+  m_dmc_factory = 0;
 }
 
 UdpGossip::~UdpGossip()
 {
   NS_LOG_FUNCTION (this);
-  uint32_t i;
-  for(i=0; i < m_num_peers; i++) {
-    m_send_sockets[i] = 0;
-  }
-  delete [] m_send_sockets;
-  delete [] m_peer_addresses;
+  m_send_sockets.clear();
   m_recv_socket = 0;
 }
 
@@ -95,17 +159,174 @@ UdpGossip::SetDmcData(DmcData *dd) {
   m_dmc_data = dd;
 }
 
+void
+UdpGossip::SetDmcDataFactory (DmcDataFactory *fact)
+{
+  NS_LOG_FUNCTION (this);
+  m_dmc_factory = fact;
+}
+
+void
+UdpGossip::EnsureDmcData ()
+{
+  if (m_dmc_data == 0) {
+    NS_ASSERT_MSG (m_dmc_factory != 0, "gossip application has no protocol");
+    m_dmc_data = m_dmc_factory->Create();
+  }
+}
+
+DmcData *
+UdpGossip::GetDmcData (void) const
+{
+  return m_dmc_data;
+}
+
+uint32_t
+UdpGossip::GetSent (void) const
+{
+  return m_sent;
+}
+
+uint64_t
+UdpGossip::GetSentBytes (void) const
+{
+  return m_sent_bytes;
+}
+
+uint32_t
+UdpGossip::GetOversized (void) const
+{
+  return m_tx_oversize;
+}
+
+bool
+UdpGossip::SetLinkUp (uint32_t peer_node_id, bool up)
+{
+  NS_LOG_FUNCTION (this << peer_node_id << up);
+  DiscoverPeers();
+  uint32_t i;
+  for(i = 0; i < m_peers.size(); i++) {
+    if (m_peers[i].node_id == peer_node_id) break;
+  }
+  if (i == m_peers.size()) return false;
+  if (m_peers[i].up == up) return true;
+
+  m_peers[i].up = up;
+  if (up) {
+    m_active.push_back(i);
+  } else {
+    m_active.erase(std::find(m_active.begin(), m_active.end(), i));
+    if (m_running && m_node_up) {
+      m_dmc_data->NeighborDown(m_peers[i].node_id);
+    }
+  }
+  NS_LOG_INFO("link to peer node " << peer_node_id << " is " <<
+              (up ? "up" : "down"));
+  return true;
+}
+
+void
+UdpGossip::SetNodeUp (bool up)
+{
+  NS_LOG_FUNCTION (this << up);
+  if (m_node_up == up) return;
+  m_node_up = up;
+  if (!m_running) return;
+  if (up) {
+    m_dmc_data->Reset();
+    ScheduleTransmit (MilliSeconds (rand() % 100));
+  } else {
+    Simulator::Cancel(m_sendEvent);
+  }
+  NS_LOG_INFO("node " << GetNode()->GetId() << " is " <<
+              (up ? "up" : "down"));
+}
+
+void
+UdpGossip::Checkpoint (std::ostream &os)
+{
+  NS_LOG_FUNCTION (this);
+  EnsureDmcData();
+  int64_t send_delay = -1;
+  if (m_running) {
+    send_delay = Simulator::GetDelayLeft(m_sendEvent).GetTimeStep();
+  }
+  uint32_t num_stats = m_peer_stats.size();
+  os.write((const char *)&m_sent, sizeof(m_sent));
+  os.write((const char *)&m_sent_bytes, sizeof(m_sent_bytes));
+  os.write((const char *)&m_rx_unknown, sizeof(m_rx_unknown));
+  os.write((const char *)&send_delay, sizeof(send_delay));
+  os.write((const char *)&num_stats, sizeof(num_stats));
+  for(uint32_t i = 0; i < num_stats; i++) {
+    int64_t last_rx = m_peer_stats[i].last_rx.GetTimeStep();
+    os.write((const char *)&m_peer_stats[i].rx_packets, sizeof(uint32_t));
+    os.write((const char *)&m_peer_stats[i].rx_bytes, sizeof(uint64_t));
+    os.write((const char *)&last_rx, sizeof(last_rx));
+  }
+
+  uint32_t bufsz = m_dmc_data->GetSnapshotSize();
+  uint8_t *buf = new uint8_t[bufsz];
+  m_dmc_data->SnapshotTo(buf);
+  os.write((const char *)&bufsz, sizeof(bufsz));
+  os.write((const char *)buf, bufsz);
+  delete [] buf;
+}
+
+void
+UdpGossip::Restore (std::istream &is)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT_MSG (!m_running, "restoring a running gossip application");
+  EnsureDmcData();
+  int64_t send_delay;
+  uint32_t num_stats;
+  is.read((char *)&m_sent, sizeof(m_sent));
+  is.read((char *)&m_sent_bytes, sizeof(m_sent_bytes));
+  is.read((char *)&m_rx_unknown, sizeof(m_rx_unknown));
+  is.read((char *)&send_delay, sizeof(send_delay));
+  is.read((char *)&num_stats, sizeof(num_stats));
+  m_peer_stats.resize(num_stats);
+  for(uint32_t i = 0; i < num_stats; i++) {
+    int64_t last_rx;
+    is.read((char *)&m_peer_stats[i].rx_packets, sizeof(uint32_t));
+    is.read((char *)&m_peer_stats[i].rx_bytes, sizeof(uint64_t));
+    is.read((char *)&last_rx, sizeof(last_rx));
+    m_peer_stats[i].last_rx = TimeStep(last_rx);
+  }
+
+  uint32_t bufsz;
+  is.read((char *)&bufsz, sizeof(bufsz));
+  uint8_t *buf = new uint8_t[bufsz];
+  is.read((char *)buf, bufsz);
+  NS_ABORT_MSG_IF (!is, "truncated gossip checkpoint");
+  m_dmc_data->RestoreFrom(buf);
+  delete [] buf;
+
+  // a stopped application had nothing pending; start it promptly
+  m_restore_send_delay = TimeStep(send_delay < 0 ? 0 : send_delay);
+  m_restored = true;
+}
+
 void
 UdpGossip::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
+  // ideal-transport peers point at each other
+  m_peer_apps.clear();
+  for(uint32_t i = 0; i < m_peers.size(); i++) {
+    m_peers[i].dev = 0;
+  }
   Application::DoDispose ();
 }
 
 Ipv4Address
 UdpGossip::GetSomeAddrOf(Ptr<Node> node) {
-  NS_LOG_FUNCTION (this);
+  NS_LOG_FUNCTION (node);
   Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+  if (ipv4 == 0) {
+    // no internet stack; any unique address will do
+    return Ipv4Address(0x0a000000 | (node->GetId() + 1));
+  }
   for(uint32_t iface = 0; iface < ipv4->GetNInterfaces(); iface++) {
     for(uint32_t addr_idx = 0; addr_idx < ipv4->GetNAddresses(iface);
         addr_idx++) {
@@ -120,57 +341,88 @@ UdpGossip::GetSomeAddrOf(Ptr<Node> node) {
   return Ipv4Address::GetZero();
 }
 
-bool
-UdpGossip::IsLoopbackInterface(uint32_t iface) {
-  NS_LOG_FUNCTION(this);
-  Ptr<Ipv4> ipv4 = GetNode()->GetObject<Ipv4>();
-  for(uint32_t i = 0; i < ipv4->GetNAddresses(iface); i++) {
-    Ipv4InterfaceAddress iaddr = ipv4->GetAddress(iface, i);
-    if (iaddr.GetLocal() == Ipv4Address::GetLoopback()) return true;
-  }
-  return false;
-}
-
-uint32_t
-UdpGossip::GetNumPeers() {
-  NS_LOG_FUNCTION(this);
-  uint32_t out = 0;
-  Ptr<Ipv4> ipv4 = GetNode()->GetObject<Ipv4>();
-  for(uint32_t iface = 0; iface < ipv4->GetNInterfaces(); iface++) {
-    if (!IsLoopbackInterface(iface)) out++;
-  }
-  return out;
+Ipv4Address
+UdpGossip::GetDeviceAddr(Ptr<NetDevice> dev) {
+  Ptr<Ipv4> ipv4 = dev->GetNode()->GetObject<Ipv4>();
+  if (ipv4 == 0) return GetSomeAddrOf(dev->GetNode());
+  uint32_t iface = ipv4->GetInterfaceForDevice(dev);
+  return ipv4->GetAddress(iface, 0).GetLocal();
 }
 
-Ipv4Address
-UdpGossip::GetPeerAddr(uint32_t iface) {
+UdpGossipNeighbor
+UdpGossip::GetPeer(Ptr<NetDevice> dev) {
   NS_LOG_FUNCTION(this);
-  Ptr<Ipv4> ipv4 = GetNode()->GetObject<Ipv4>();
-  Ptr<NetDevice> dev = ipv4->GetNetDevice(iface);
   Ptr<Channel> chan = dev->GetChannel();
   Ptr<NetDevice> otherDev;
   for(uint32_t i=0; i < chan->GetNDevices(); i++) {
     otherDev = chan->GetDevice(i);
     if (otherDev->GetAddress() != dev->GetAddress()) break;
   }
-  Ptr<Ipv4> otherIpv4 = otherDev->GetNode()->GetObject<Ipv4>();
-  uint32_t otherIface = otherIpv4->GetInterfaceForDevice(otherDev);
-  Ipv4InterfaceAddress iaddr = otherIpv4->GetAddress(otherIface, 0);
-  return iaddr.GetLocal();
+  UdpGossipNeighbor peer;
+  peer.addr = GetDeviceAddr(otherDev);
+  peer.node_id = otherDev->GetNode()->GetId();
+  peer.dev = dev;
+  peer.up = true;
+  return peer;
 }
 
-Ptr<Node>
-UdpGossip::GetPeerNode(uint32_t iface) {
+void
+UdpGossip::DiscoverPeers() {
   NS_LOG_FUNCTION(this);
-  Ptr<Ipv4> ipv4 = GetNode()->GetObject<Ipv4>();
-  Ptr<NetDevice> dev = ipv4->GetNetDevice(iface);
-  Ptr<Channel> chan = dev->GetChannel();
-  Ptr<NetDevice> otherDev;
-  for(uint32_t i=0; i < chan->GetNDevices(); i++) {
-    otherDev = chan->GetDevice(i);
-    if (otherDev->GetAddress() != dev->GetAddress()) break;
+  if (m_peers_discovered) return;
+  Ptr<Node> node = GetNode();
+  m_peers.reserve(node->GetNDevices());
+  for(uint32_t i = 0; i < node->GetNDevices(); i++) {
+    Ptr<NetDevice> dev = node->GetDevice(i);
+    // the loopback device has no channel
+    if (dev->GetChannel() != 0) {
+      m_peers.push_back(GetPeer(dev));
+    }
+  }
+  IndexPeers();
+}
+
+void
+UdpGossip::SetNeighbors (const std::vector<UdpGossipNeighbor> &peers)
+{
+  NS_LOG_FUNCTION (this << peers.size());
+  NS_ASSERT_MSG (!m_running, "setting the peers of a running application");
+  m_peers = peers;
+  m_peer_index.clear();
+  m_active.clear();
+  IndexPeers();
+}
+
+void
+UdpGossip::IndexPeers() {
+  NS_LOG_FUNCTION(this);
+  // restored stats are kept as long as they still line up with the peers
+  if (m_peer_stats.size() != m_peers.size()) {
+    UdpGossipPeerStats empty;
+    empty.rx_packets = 0;
+    empty.rx_bytes = 0;
+    m_peer_stats.assign(m_peers.size(), empty);
+  }
+  UdpGossipReassembly idle;
+  idle.seq = 0;
+  idle.count = 0;
+  idle.received = 0;
+  m_reassembly.assign(m_peers.size(), idle);
+  m_peer_index.rehash(m_peers.size());
+  m_active.reserve(m_peers.size());
+  for(uint32_t i = 0; i < m_peers.size(); i++) {
+    m_peer_index[m_peers[i].addr.Get()] = i;
+    m_active.push_back(i);
   }
-  return otherDev->GetNode();
+  m_peers_discovered = true;
+}
+
+int32_t
+UdpGossip::LookupPeer(Ipv4Address addr) const {
+  std::tr1::unordered_map<uint32_t, uint32_t>::const_iterator it =
+    m_peer_index.find(addr.Get());
+  if (it == m_peer_index.end()) return -1;
+  return it->second;
 }
 
 void 
@@ -178,7 +430,9 @@ UdpGossip::StartApplication (void)
 {
   NS_LOG_FUNCTION (this);
 
+  EnsureDmcData();
   m_myaddr = GetSomeAddrOf(GetNode());
+  m_dmc_data->SetMyNodeId(GetNode()->GetId());
   m_dmc_data->SetMyIpv4Address(m_myaddr);
 
   if (m_d3_output) {
@@ -187,6 +441,51 @@ UdpGossip::StartApplication (void)
                 ",addr:\"" << a << "\"});");
   }
 
+  DiscoverPeers();
+  NS_LOG_DEBUG("setting up " << m_peers.size() << " peers");
+  m_running = true;
+  switch (m_transport) {
+  case TRANSPORT_UDP:
+    SetupUdp();
+    break;
+  case TRANSPORT_RAW:
+    SetupRaw();
+    break;
+  case TRANSPORT_IDEAL:
+    SetupIdeal();
+    break;
+  }
+
+  for(uint32_t i = 0; i < m_peers.size(); i++) {
+    if (m_d3_output) {
+      uint32_t src = GetNode()->GetId();
+      uint32_t tgt = m_peers[i].node_id;
+      if (src < tgt) {
+        NS_LOG_INFO("D3 links.push({source:" << src <<
+                    ",target:" << tgt <<
+                    "});");
+      }
+    } else {
+      NS_LOG_INFO("established link to peer node " << m_peers[i].node_id <<
+                  " at " << m_peers[i].addr << ":" << m_port);
+    }
+  }
+
+  if (!m_node_up) {
+    // failed before it got going; SetNodeUp will start it
+  } else if (m_restored) {
+    ScheduleTransmit (m_restore_send_delay);
+    m_restored = false;
+  } else {
+    ScheduleTransmit (MilliSeconds (rand() % 100));
+  }
+}
+
+void
+UdpGossip::SetupUdp ()
+{
+  NS_LOG_FUNCTION (this);
+
   // set up receive socket
   if (m_recv_socket == 0) {
     NS_LOG_DEBUG("Setting up receiving socket");
@@ -198,48 +497,51 @@ UdpGossip::StartApplication (void)
   m_recv_socket->SetRecvCallback(MakeCallback(&UdpGossip::HandleRead, this));
 
   // set up peer sockets
-  m_num_peers = GetNumPeers();
-  m_peer_addresses = new Ipv4Address[m_num_peers];
-  m_send_sockets = new Ptr<Socket>[m_num_peers];
-  m_peer_nodes = new Ptr<Node>[m_num_peers];
-  NS_LOG_DEBUG("setting up " << m_num_peers << " peers");
-
-  Ptr<Ipv4> ipv4 = GetNode()->GetObject<Ipv4>();
-  uint32_t peers = 0;
-  for(uint32_t iface = 0; iface < ipv4->GetNInterfaces(); iface++) {
-    if (!IsLoopbackInterface(iface)) {
-      Ipv4Address peerAddr = GetPeerAddr(iface);
-      Ptr<Socket> ssock = m_send_sockets[peers];
-      if (ssock == 0) {
-        TypeId tid = TypeId::LookupByName ("ns3::UdpSocketFactory");
-        ssock = Socket::CreateSocket (GetNode (), tid);
-
-        m_peer_addresses[peers] = peerAddr;
-        m_peer_nodes[peers] = GetPeerNode(iface);
-
-        ssock->Bind();
-        ssock->Connect (InetSocketAddress (peerAddr, m_port));
-        if (m_d3_output) {
-          uint32_t src = GetNode()->GetId();
-          uint32_t tgt = GetPeerNode(iface)->GetId();
-          if (src < tgt) {
-            NS_LOG_INFO("D3 links.push({source:" << src <<
-                        ",target:" << tgt <<
-                        "});");
-          }
-        } else {
-          NS_LOG_INFO("established socket to peer node "
-                      << GetPeerNode(iface)->GetId()
-                      << " at " << peerAddr << ":" << m_port);
-        }
-
-        m_send_sockets[peers] = ssock;
-      }
-      peers++;
+  if (m_single_socket) return;
+  m_send_sockets.resize(m_peers.size());
+  for(uint32_t i = 0; i < m_peers.size(); i++) {
+    if (m_send_sockets[i] == 0) {
+      TypeId tid = TypeId::LookupByName ("ns3::UdpSocketFactory");
+      Ptr<Socket> ssock = Socket::CreateSocket (GetNode (), tid);
+      ssock->Bind();
+      ssock->Connect (InetSocketAddress (m_peers[i].addr, m_port));
+      m_send_sockets[i] = ssock;
     }
   }
+}
+
+void
+UdpGossip::SetupRaw ()
+{
+  NS_LOG_FUNCTION (this);
+  NS_ABORT_MSG_IF (GetNode()->GetObject<Ipv4>() != 0,
+                   "raw gossip transport needs nodes without an internet "
+                   "stack (node " << GetNode()->GetId() << ")");
+  for(uint32_t i = 0; i < m_peers.size(); i++) {
+    GetNode()->RegisterProtocolHandler(
+      MakeCallback(&UdpGossip::HandleRawRead, this),
+      GOSSIP_RAW_PROTOCOL, m_peers[i].dev);
+  }
+}
 
-  ScheduleTransmit (MilliSeconds (rand() % 100));
+void
+UdpGossip::SetupIdeal ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_peer_apps.size() == m_peers.size()) return;
+  m_peer_apps.resize(m_peers.size());
+  for(uint32_t i = 0; i < m_peers.size(); i++) {
+    Ptr<Node> peer = NodeList::GetNode(m_peers[i].node_id);
+    for(uint32_t j = 0; j < peer->GetNApplications(); j++) {
+      Ptr<UdpGossip> app = DynamicCast<UdpGossip>(peer->GetApplication(j));
+      if (app != 0) {
+        m_peer_apps[i] = app;
+        break;
+      }
+    }
+    NS_ABORT_MSG_IF (m_peer_apps[i] == 0, "peer node " <<
+                     m_peers[i].node_id << " runs no gossip application");
+  }
 }
 
 void 
@@ -247,8 +549,36 @@ UdpGossip::StopApplication ()
 {
   NS_LOG_FUNCTION (this);
 
+  // stopped before it started: bulk installs haven't even created the
+  // protocol state yet, and there are no sockets or handlers to undo
+  if (!m_running) return;
+  m_running = false;
   m_dmc_data->LogMemory();
 
+  for(uint32_t i = 0; i < m_peer_stats.size(); i++) {
+    NS_LOG_DEBUG("peer " << m_peers[i].addr << ": rx_packets=" <<
+                 m_peer_stats[i].rx_packets << " rx_bytes=" <<
+                 m_peer_stats[i].rx_bytes << " last_rx=" <<
+                 m_peer_stats[i].last_rx.GetSeconds());
+  }
+  if (m_rx_unknown > 0) {
+    NS_LOG_INFO("dropped " << m_rx_unknown <<
+                " packets from senders that are not direct peers");
+  }
+  if (m_tx_oversize > 0) {
+    NS_LOG_INFO("did not send " << m_tx_oversize << " messages of more than " <<
+                m_max_segments << " segments");
+  }
+  if (m_rx_incomplete > 0) {
+    NS_LOG_INFO("abandoned " << m_rx_incomplete <<
+                " messages with segments missing");
+  }
+
+  if (m_transport == TRANSPORT_RAW) {
+    GetNode()->UnregisterProtocolHandler(
+      MakeCallback(&UdpGossip::HandleRawRead, this));
+  }
+
   if (m_recv_socket != 0) 
     {
       m_recv_socket->Close ();
@@ -256,15 +586,14 @@ UdpGossip::StopApplication ()
       m_recv_socket = 0;
     }
 
-  uint32_t i;
-  for(i=0; i < m_num_peers; i++) {
+  for(uint32_t i=0; i < m_send_sockets.size(); i++) {
     Ptr<Socket> sock = m_send_sockets[i];
     if (sock != 0) {
       sock->Close();
       sock->SetRecvCallback(MakeNullCallback<void, Ptr<Socket> >());
     }
-    m_send_sockets[i] = sock = 0;
   }
+  m_send_sockets.clear();
   
   // for(std::list<EventId>::iterator it = m_sendEvents.begin();
   //     it != m_sendEvents.end(); it++) {
@@ -285,41 +614,125 @@ UdpGossip::Send (void)
 {
   NS_LOG_FUNCTION (this);
 
-  uint8_t *buf;
+  uint32_t bufsz = EncodeState(m_tx_buf);
 
-  uint32_t bufsz = m_dmc_data->GetMarshalledSize();
-  buf = new uint8_t[bufsz];
-  m_dmc_data->MarshalTo(buf);
-
-  Ptr<Packet> p;
-  p = Create<Packet> (buf, bufsz);
+  if (m_active.empty()) {
+    // every link is down; keep checking in case one comes back
+    ScheduleTransmit(MilliSeconds (rand() % 100));
+    return;
+  }
 
-  // call to the trace sinks before the packet is actually sent,
-  // so that tags added to the packet can be sent as well
-  m_txTrace (p);
-  
   // pick a peer to send to
-  uint32_t peer_idx = rand() % m_num_peers;
-  m_send_sockets[peer_idx]->Send(p);
-  
-  delete [] buf;
+  uint32_t peer_idx = m_active[rand() % m_active.size()];
+
+  // a message too big for one packet goes as a burst of segments, in
+  // the order the protocol asks for, rather than as an IP-fragmented
+  // datagram
+  uint32_t max_payload = GetSegmentPayload();
+  m_segments.clear();
+  if (bufsz <= max_payload) {
+    DmcSegment whole = { 0, bufsz };
+    m_segments.push_back(whole);
+  } else {
+    m_dmc_data->Segment(&m_tx_buf[0], bufsz, max_payload, m_segments);
+  }
+  if (m_segments.size() > m_max_segments) {
+    NS_LOG_WARN("message of " << bufsz << " bytes needs " <<
+                m_segments.size() << " segments; not sending it");
+    m_tx_oversize++;
+    ScheduleTransmit(MilliSeconds (rand() % 100));
+    return;
+  }
+
+  uint16_t seq = m_tx_seq++;
+  for(uint32_t i = 0; i < m_segments.size(); i++) {
+    const DmcSegment &seg = m_segments[i];
+    Ptr<Packet> p = Create<Packet> (&m_tx_buf[seg.offset], seg.length);
+    GossipSegmentHeader header;
+    header.Set(seq, i, m_segments.size(), seg.offset, bufsz);
+    p->AddHeader(header);
+    if (i == 0) {
+      SendSegment(peer_idx, p);
+    } else {
+      Simulator::Schedule(TimeStep(m_segment_gap.GetTimeStep() * i),
+                          &UdpGossip::SendSegment, this, peer_idx, p);
+    }
+  }
 
   ++m_sent;
+  m_sent_bytes += bufsz;
 
-  Ipv4Address peerAddress = m_peer_addresses[peer_idx];
   if (m_d3_output) {
     NS_LOG_INFO("D3 events.push({type:\"send\",from:" <<
                 GetNode()->GetId() << ",to:" <<
-                m_peer_nodes[peer_idx]->GetId() << ",time:" <<
+                m_peers[peer_idx].node_id << ",time:" <<
                 Simulator::Now().GetSeconds() << "});");
   } else {
-    NS_LOG_INFO("SEND: to=" << peerAddress << " from=" << m_myaddr);
+    NS_LOG_INFO("SEND: to=" << m_peers[peer_idx].addr << " from=" <<
+                m_myaddr << " segments=" << m_segments.size());
   }
 
   // continuous sending
   ScheduleTransmit(MilliSeconds (rand() % 100));
 }
 
+void
+UdpGossip::SendSegment (uint32_t peer_idx, Ptr<Packet> p)
+{
+  NS_LOG_FUNCTION (this << peer_idx);
+  if (!m_running || !m_node_up || !m_peers[peer_idx].up) return;
+
+  // call to the trace sinks before the packet is actually sent,
+  // so that tags added to the packet can be sent as well
+  m_txTrace (p);
+
+  Ipv4Address peerAddress = m_peers[peer_idx].addr;
+  switch (m_transport) {
+  case TRANSPORT_UDP:
+    if (m_single_socket) {
+      m_recv_socket->SendTo(p, 0, InetSocketAddress (peerAddress, m_port));
+    } else {
+      m_send_sockets[peer_idx]->Send(p);
+    }
+    break;
+  case TRANSPORT_RAW:
+    {
+      GossipHeader header;
+      header.SetSender(m_myaddr);
+      p->AddHeader(header);
+      Ptr<NetDevice> dev = m_peers[peer_idx].dev;
+      dev->Send(p, dev->GetBroadcast(), GOSSIP_RAW_PROTOCOL);
+    }
+    break;
+  case TRANSPORT_IDEAL:
+    if (m_loss_rv->GetValue() >= m_ideal_loss) {
+      Simulator::ScheduleWithContext(m_peers[peer_idx].node_id, m_ideal_delay,
+                                     &UdpGossip::HandleIdealRead,
+                                     m_peer_apps[peer_idx], m_myaddr, p);
+    }
+    break;
+  }
+}
+
+uint32_t
+UdpGossip::GetSegmentPayload (void) const
+{
+  uint32_t overhead = GossipSegmentHeader().GetSerializedSize();
+  switch (m_transport) {
+  case TRANSPORT_UDP:
+    overhead += 20 + 8; // IPv4 and UDP headers, no options
+    break;
+  case TRANSPORT_RAW:
+    overhead += GossipHeader().GetSerializedSize();
+    break;
+  case TRANSPORT_IDEAL:
+    // no headers of its own; sized as for UDP so the two compare
+    overhead += 20 + 8;
+    break;
+  }
+  return m_mtu - overhead;
+}
+
 void
 UdpGossip::HandleRead (Ptr<Socket> socket)
 {
@@ -327,26 +740,119 @@ UdpGossip::HandleRead (Ptr<Socket> socket)
   Ptr<Packet> packet;
   Address from;
   while ((packet = socket->RecvFrom (from))) {
-    Ipv4Address src = InetSocketAddress::ConvertFrom(from).GetIpv4();
-    uint32_t bufsz = packet->GetSize();
-    uint8_t *buf = new uint8_t[bufsz];
-    packet->CopyData(buf, bufsz);
-    if (m_d3_output) {
-      for(uint32_t i=0; i<m_num_peers; i++) {
-        if (m_peer_addresses[i].IsEqual(src)) {
-          NS_LOG_INFO("D3 events.push({type:\"recv\",from:" <<
-                      m_peer_nodes[i]->GetId() << ",to:" <<
-                      GetNode()->GetId() << ",time:" <<
-                      Simulator::Now().GetSeconds() << "});");
-        }
+    Receive(InetSocketAddress::ConvertFrom(from).GetIpv4(), packet);
+  }
+}
+
+void
+UdpGossip::HandleRawRead (Ptr<NetDevice> dev, Ptr<const Packet> packet,
+                          uint16_t protocol, const Address &from,
+                          const Address &to, NetDevice::PacketType type)
+{
+  NS_LOG_FUNCTION (this << dev);
+  Ptr<Packet> copy = packet->Copy();
+  GossipHeader header;
+  copy->RemoveHeader(header);
+  Receive(header.GetSender(), copy);
+}
+
+void
+UdpGossip::HandleIdealRead (Ipv4Address src, Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << src);
+  // the sender doesn't know whether this application is running
+  if (!m_running) return;
+  Receive(src, packet);
+}
+
+void
+UdpGossip::Receive (Ipv4Address src, Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << src);
+  int32_t peer_idx = LookupPeer(src);
+  if (peer_idx < 0) {
+    NS_LOG_DEBUG("ignoring packet from " << src << ", not a direct peer");
+    m_rx_unknown++;
+    return;
+  }
+  if (!m_node_up || !m_peers[peer_idx].up) {
+    NS_LOG_DEBUG("ignoring packet from " << src << ", link is down");
+    return;
+  }
+  GossipSegmentHeader header;
+  packet->RemoveHeader(header);
+  uint32_t bufsz = packet->GetSize();
+  UdpGossipPeerStats &stats = m_peer_stats[peer_idx];
+  stats.rx_packets++;
+  stats.rx_bytes += bufsz;
+  stats.last_rx = Simulator::Now();
+
+  const uint8_t *msg;
+  if (header.GetCount() <= 1) {
+    m_rx_buf.resize(bufsz);
+    packet->CopyData(&m_rx_buf[0], bufsz);
+    msg = &m_rx_buf[0];
+  } else {
+    // the protocol reads levels missing from a message as vacated, so
+    // it only ever sees whole messages
+    UdpGossipReassembly &r = m_reassembly[peer_idx];
+    if (r.received > 0 && r.seq != header.GetSeq()) {
+      if ((int16_t)(header.GetSeq() - r.seq) < 0) {
+        NS_LOG_DEBUG("ignoring segment of an older message from " << src);
+        return;
       }
-    } else {
-      NS_LOG_INFO("RECV: from=" << src << " sz=" << bufsz << " bytes");
+      m_rx_incomplete++;
+      r.received = 0;
+    }
+    if (r.received == 0) {
+      r.seq = header.GetSeq();
+      r.count = header.GetCount();
+      r.got.assign(r.count, false);
+      r.buf.resize(header.GetTotal());
+    }
+    if (header.GetCount() != r.count || header.GetIndex() >= r.count ||
+        header.GetOffset() + bufsz > r.buf.size()) {
+      NS_LOG_DEBUG("ignoring malformed segment from " << src);
+      return;
     }
-    m_dmc_data->MarshalFrom(buf);
-    delete [] buf;
+    // a duplicate must not stand in for a segment still missing
+    if (r.got[header.GetIndex()]) {
+      NS_LOG_DEBUG("ignoring duplicate segment from " << src);
+      return;
+    }
+    r.got[header.GetIndex()] = true;
+    packet->CopyData(&r.buf[header.GetOffset()], bufsz);
+    if (++r.received < r.count) return;
+    r.received = 0;
+    bufsz = r.buf.size();
+    msg = &r.buf[0];
   }
-  
+
+  if (m_d3_output) {
+    NS_LOG_INFO("D3 events.push({type:\"recv\",from:" <<
+                m_peers[peer_idx].node_id << ",to:" <<
+                GetNode()->GetId() << ",time:" <<
+                Simulator::Now().GetSeconds() << "});");
+  } else {
+    NS_LOG_INFO("RECV: from=" << src << " sz=" << bufsz << " bytes");
+  }
+  DecodeState(msg);
+}
+
+uint32_t
+UdpGossip::EncodeState (std::vector<uint8_t> &buf)
+{
+  m_dmc_data->PrepareToSend();
+  uint32_t bufsz = m_dmc_data->GetMarshalledSize();
+  buf.resize(bufsz);
+  m_dmc_data->MarshalTo(&buf[0]);
+  return bufsz;
+}
+
+void
+UdpGossip::DecodeState (const uint8_t *buf)
+{
+  m_dmc_data->MarshalFrom(buf);
 }
 
 } // Namespace ns3
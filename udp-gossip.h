@@ -19,6 +19,8 @@
 #ifndef UDP_GOSSIP_H
 #define UDP_GOSSIP_H
 
+#include <vector>
+#include <tr1/unordered_map>
 #include "ns3/application.h"
 #include "ns3/event-id.h"
 #include "ns3/ptr.h"
@@ -28,7 +30,6 @@
 #include "ns3/network-module.h"
 #include "ns3/internet-module.h"
 #include "ns3/point-to-point-module.h"
-#include "ns3/applications-module.h"
 #include "ns3/address.h"
 #include "ns3/dmc-data.h"
 #include "dmc-data.h"
@@ -38,6 +39,42 @@ namespace ns3 {
 class Socket;
 class Packet;
 
+/**
+ * \ingroup udpgossip
+ * \brief A directly connected gossip peer, discovered once at startup
+ */
+struct UdpGossipNeighbor
+{
+  Ipv4Address addr;   //!< peer's address on the shared point-to-point link
+  uint32_t node_id;   //!< peer's ns-3 node id
+  Ptr<NetDevice> dev; //!< my device on the link to this peer
+  bool up;            //!< whether the link to this peer is usable
+};
+
+/**
+ * \ingroup udpgossip
+ * \brief Receive statistics for one peer, indexed like the peer array
+ */
+struct UdpGossipPeerStats
+{
+  uint32_t rx_packets; //!< packets received from the peer
+  uint64_t rx_bytes;   //!< payload bytes received from the peer
+  Time last_rx;        //!< time of the most recent receive
+};
+
+/**
+ * \ingroup udpgossip
+ * \brief A segmented message from one peer, still being put together
+ */
+struct UdpGossipReassembly
+{
+  uint16_t seq;              //!< the message's sequence number
+  uint16_t count;            //!< segments in the message
+  uint16_t received;         //!< segments so far; 0 when idle
+  std::vector<bool> got;     //!< which segments have arrived
+  std::vector<uint8_t> buf;  //!< the message, filled in by offset
+};
+
 /**
  * \ingroup udpgossip
  * \brief A Udp Gossip application
@@ -53,6 +90,16 @@ public:
    */
   static TypeId GetTypeId (void);
 
+  /**
+   * \brief How gossip messages reach a peer
+   */
+  enum Transport
+  {
+    TRANSPORT_UDP,   //!< UDP sockets over the node's internet stack
+    TRANSPORT_RAW,   //!< GossipHeader frames straight onto the link device
+    TRANSPORT_IDEAL  //!< direct delivery with fixed delay and random loss
+  };
+
   UdpGossip ();
   virtual ~UdpGossip ();
 
@@ -63,9 +110,101 @@ public:
   void SetPort (uint16_t port);
   void SetDmcData (DmcData *dd);
 
+  /**
+   * \brief Create the protocol state from fact when it is first needed
+   *
+   * Used instead of SetDmcData by bulk installs, so that the protocol
+   * state for a node is only built once the node starts (or is restored).
+   */
+  void SetDmcDataFactory (DmcDataFactory *fact);
+
+  /**
+   * \return the protocol state, or 0 if it has not been created yet
+   */
+  DmcData *GetDmcData (void) const;
+
+  /**
+   * \brief Give the application its direct peers up front
+   *
+   * Replaces the walk over the node's devices done at startup; the
+   * peers must be in the node's device order.
+   */
+  void SetNeighbors (const std::vector<UdpGossipNeighbor> &peers);
+
+  /**
+   * \brief The address a node is known by to the gossip protocol
+   *
+   * This is the node's first non-loopback IPv4 address; nodes without an
+   * internet stack (raw and ideal transports) get one derived from their
+   * node id.
+   */
+  static Ipv4Address GetSomeAddrOf(Ptr<Node> node);
+
+  /**
+   * \brief Number of messages sent so far
+   */
+  uint32_t GetSent (void) const;
+
+  /**
+   * \brief Number of payload bytes sent so far
+   */
+  uint64_t GetSentBytes (void) const;
+
+  /**
+   * \brief Number of messages not sent for needing more than
+   *        MaxSegments segments
+   */
+  uint32_t GetOversized (void) const;
+
+  /**
+   * \brief Take the link to a direct peer down or bring it back up
+   *
+   * While a link is down nothing is sent to the peer and anything
+   * received from it is ignored.  Taking it down tells the protocol the
+   * neighbor is gone.
+   *
+   * \param peer_node_id node id of the peer at the far end of the link
+   * \param up the new link state
+   * \return false if the node has no link to that peer
+   */
+  bool SetLinkUp (uint32_t peer_node_id, bool up);
+
+  /**
+   * \brief Fail this node, or have it rejoin with fresh protocol state
+   */
+  void SetNodeUp (bool up);
+
+  /**
+   * \brief Write counters, pending send time and protocol state to os
+   */
+  void Checkpoint (std::ostream &os);
+
+  /**
+   * \brief Load state written by Checkpoint
+   *
+   * Must be called before the application starts; the first send is then
+   * scheduled with the delay that was pending when the checkpoint was
+   * taken.
+   */
+  void Restore (std::istream &is);
+
 protected:
   virtual void DoDispose (void);
 
+  /**
+   * \brief Marshal the protocol state into buf for sending
+   * \return the number of bytes used
+   *
+   * Each is called once per message; UdpGossipApp overrides both to call
+   * its protocol directly instead of through DmcData.
+   */
+  virtual uint32_t EncodeState (std::vector<uint8_t> &buf);
+
+  /**
+   * \brief Hand a received message to the protocol state
+   */
+  virtual void DecodeState (const uint8_t *buf);
+
 private:
 
   virtual void StartApplication (void);
@@ -82,6 +221,19 @@ private:
    */
   void Send (void);
 
+  /**
+   * \brief Send one segment of a message to a peer
+   *
+   * Later segments of a burst are scheduled, so the node or link may
+   * have gone down by the time they are due; they are dropped then.
+   */
+  void SendSegment (uint32_t peer_idx, Ptr<Packet> p);
+
+  /**
+   * \return the most message bytes one packet can carry under Mtu
+   */
+  uint32_t GetSegmentPayload (void) const;
+
   /**
    * \brief Handle a packet reception.
    *
@@ -91,27 +243,107 @@ private:
    */
   void HandleRead (Ptr<Socket> socket);
 
-  Ipv4Address GetSomeAddrOf(Ptr<Node> node);
-  bool IsLoopbackInterface(uint32_t iface);
-  Ipv4Address GetPeerAddr(uint32_t iface);
-  Ptr<Node> GetPeerNode(uint32_t iface);
-  uint32_t GetNumPeers();
+  /**
+   * \brief Handle a frame received directly from a link device
+   *
+   * Used by TRANSPORT_RAW; the frame starts with a GossipHeader.
+   */
+  void HandleRawRead (Ptr<NetDevice> dev, Ptr<const Packet> packet,
+                      uint16_t protocol, const Address &from,
+                      const Address &to, NetDevice::PacketType type);
+
+  /**
+   * \brief Handle a message delivered by TRANSPORT_IDEAL
+   */
+  void HandleIdealRead (Ipv4Address src, Ptr<Packet> packet);
+
+  /**
+   * \brief Hand a received message from src to the protocol
+   *
+   * Segments of a larger message are held until the last one arrives;
+   * a segment of a newer message from the same peer abandons an
+   * unfinished one.
+   */
+  void Receive (Ipv4Address src, Ptr<Packet> packet);
+
+  void SetupUdp ();
+  void SetupRaw ();
+  void SetupIdeal ();
+
+  /**
+   * \brief The address of the peer reached through a link device
+   */
+  static Ipv4Address GetDeviceAddr(Ptr<NetDevice> dev);
+
+  /**
+   * \brief Find the peer at the far end of a point-to-point device
+   *
+   * Walks the device's channel once to get both the peer's address
+   * and its node id.
+   */
+  UdpGossipNeighbor GetPeer(Ptr<NetDevice> dev);
+
+  /**
+   * \brief Populate m_peers from the node's interfaces; only done once
+   */
+  void DiscoverPeers();
+
+  /**
+   * \brief Build the lookup index, stats and active list for m_peers
+   */
+  void IndexPeers();
+
+  /**
+   * \brief Create m_dmc_data from the factory if it isn't there yet
+   */
+  void EnsureDmcData();
+
+  /**
+   * \brief Map a sender address to its index in m_peers
+   * \return the peer index, or -1 if the sender is not a direct peer
+   */
+  int32_t LookupPeer(Ipv4Address addr) const;
 
   Time m_interval; //!< Packet inter-send time
 
   uint32_t m_sent; //!< Counter for sent packets
+  uint64_t m_sent_bytes; //!< Counter for sent payload bytes
   uint16_t m_port; //!< Port number
   bool m_d3_output;
-  uint32_t m_num_peers;
-  Ipv4Address *m_peer_addresses;
-  Ptr<Node> *m_peer_nodes;
+  bool m_single_socket; //!< Send to all peers via the receive socket
+  Transport m_transport;
+  Time m_ideal_delay; //!< TRANSPORT_IDEAL one-way delay
+  double m_ideal_loss; //!< TRANSPORT_IDEAL drop probability
+  Ptr<UniformRandomVariable> m_loss_rv;
+  std::vector<Ptr<UdpGossip> > m_peer_apps; //!< TRANSPORT_IDEAL peers
+  bool m_peers_discovered;
+  bool m_running;
+  bool m_restored; //!< Restore() ran; use m_restore_send_delay
+  Time m_restore_send_delay;
+  std::vector<UdpGossipNeighbor> m_peers; //!< Directly connected peers
+  std::vector<uint32_t> m_active; //!< m_peers indices whose link is up
+  bool m_node_up;
+  std::tr1::unordered_map<uint32_t, uint32_t> m_peer_index; //!< addr -> m_peers index
+  std::vector<UdpGossipPeerStats> m_peer_stats; //!< Parallel to m_peers
+  uint32_t m_rx_unknown; //!< Packets from senders that aren't direct peers
+  uint32_t m_mtu; //!< Largest packet, including IP/UDP or raw headers
+  uint32_t m_max_segments; //!< Most segments one message may take
+  Time m_segment_gap; //!< Spacing of the segments of a message
+  uint16_t m_tx_seq; //!< Number of the next message sent
+  uint32_t m_tx_oversize; //!< Messages too big to send
+  uint32_t m_rx_incomplete; //!< Messages abandoned unfinished
+  std::vector<DmcSegment> m_segments; //!< Reused by Send
+  std::vector<UdpGossipReassembly> m_reassembly; //!< Parallel to m_peers
   Ipv4Address m_myaddr;
-  Ptr<Socket> *m_send_sockets; //!< Peer sockets
+  std::vector<Ptr<Socket> > m_send_sockets; //!< Per-peer connected sockets
   Ptr<Socket> m_recv_socket;
   
   EventId m_sendEvent;
 
   DmcData* m_dmc_data;
+  DmcDataFactory* m_dmc_factory; //!< Creates m_dmc_data on first use
+  std::vector<uint8_t> m_tx_buf; //!< Reused by Send
+  std::vector<uint8_t> m_rx_buf; //!< Reused by Receive
 
   /// Callbacks for tracing the packet Tx events
   TracedCallback<Ptr<const Packet> > m_txTrace;